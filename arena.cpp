@@ -0,0 +1,40 @@
+#include <cstdint>
+
+#include "arena.h"
+
+Arena::Arena()
+{
+}
+
+Arena::~Arena()
+{
+	// Destroy in reverse order of creation, like automatic variables.
+	for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+	{
+		it->second(it->first);
+	}
+}
+
+void *
+Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+	if (padding + size > remaining)
+	{
+		// Objects larger than a block get a block of their own.
+		std::size_t blockSize = BLOCK_SIZE;
+		if (size + alignment > blockSize)
+		{
+			blockSize = size + alignment;
+		}
+		blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+		next = blocks.back().get();
+		remaining = blockSize;
+		padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+	}
+
+	void *memory = next + padding;
+	next += padding + size;
+	remaining -= padding + size;
+	return memory;
+}
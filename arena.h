@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump allocator holding the syntax tree of one compilation. Nodes are
+ * allocated one after another in large blocks, and are all freed
+ * together when the Arena is destroyed.
+ */
+class Arena
+{
+public:
+	Arena();
+
+	Arena(const Arena &) = delete;
+
+	Arena &operator=(const Arena &) = delete;
+
+	~Arena();
+
+	/*
+	 * Create an object in the arena. It is destroyed with the arena.
+	 */
+	template <class T, class... Args>
+	T *
+	make(Args&&... args)
+	{
+		void *memory = allocate(sizeof(T), alignof(T));
+		T *object = new (memory) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			destructors.emplace_back(object, &destroy<T>);
+		}
+		return object;
+	}
+
+private:
+	static const std::size_t BLOCK_SIZE = 64 * 1024;
+
+	std::vector<std::unique_ptr<char[]>> blocks;
+
+	char *next = nullptr;
+
+	std::size_t remaining = 0;
+
+	std::vector<std::pair<void *, void (*)(void *)>> destructors;
+
+	void *allocate(std::size_t size, std::size_t alignment);
+
+	template <class T>
+	static void
+	destroy(void *object)
+	{
+		static_cast<T *>(object)->~T();
+	}
+};
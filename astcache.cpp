@@ -0,0 +1,1224 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "astcache.h"
+#include "resolver.h"
+#include "stringtable.h"
+#include "utf8.h"
+
+/*
+ * Tag written before each node. NONE is written for a missing node, such
+ * as an else branch that is not there.
+ */
+enum class NodeTag : std::uint8_t
+{
+	NONE,
+	ASSIGN,
+	BINARY,
+	CALL,
+	GET,
+	GROUPING,
+	DOUBLE_LITERAL,
+	STRING_LITERAL,
+	BOOLEAN_LITERAL,
+	NIL_LITERAL,
+	LOGICAL,
+	SET,
+	SUPER,
+	THIS,
+	UNARY,
+	VARIABLE,
+	BLOCK,
+	CLASS,
+	EXPRESSION,
+	FUNCTION,
+	IF,
+	PRINT,
+	RETURN,
+	VAR,
+	WHILE,
+	FOR
+};
+
+/*
+ * Changed whenever the format, or the syntax tree, changes.
+ */
+static const std::uint32_t CACHE_VERSION = 5;
+
+/*
+ * Deepest nesting of nodes read, well beyond what the parser can parse
+ * without overflowing its own stack.
+ */
+static const std::size_t MAX_NESTING = 10000;
+
+static const char CACHE_MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+/*
+ * Start of a cache file. The cache is only read on the machine that
+ * wrote it, so numbers are written in its byte order.
+ */
+class CacheHeader
+{
+public:
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t sourceSize;
+	std::int64_t mtimeSeconds;
+	std::int64_t mtimeNanoseconds;
+	std::uint64_t sourceHash;
+	std::uint64_t treeHash;
+};
+
+static void
+append(std::string &out, const void *value, std::size_t size)
+{
+	out.append(static_cast<const char *>(value), size);
+}
+
+/*
+ * Write a number seven bits at a time, low bits first, with the top bit
+ * set on all bytes but the last, as most numbers are small.
+ */
+static void
+appendInt(std::string &out, std::uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<char>(value));
+}
+
+std::string
+AstWriter::write(const std::vector<Stmt *> &statements)
+{
+	writeStatements(statements);
+
+	std::string out;
+	appendInt(out, stringCount);
+	out.append(strings);
+	out.append(nodes);
+	return out;
+}
+
+void
+AstWriter::writeByte(std::uint8_t value)
+{
+	append(nodes, &value, sizeof(value));
+}
+
+void
+AstWriter::writeInt(std::uint32_t value)
+{
+	appendInt(nodes, value);
+}
+
+void
+AstWriter::writeSignedInt(std::int32_t value)
+{
+	// Zigzag encoding, so that -1 is small too.
+	writeInt((static_cast<std::uint32_t>(value) << 1) ^ (value < 0 ? ~0U : 0U));
+}
+
+void
+AstWriter::writeDouble(double value)
+{
+	append(nodes, &value, sizeof(value));
+}
+
+void
+AstWriter::writeString(std::string_view value)
+{
+	std::string key(value);
+	auto it = stringIndexes.find(key);
+	if (it != stringIndexes.end())
+	{
+		writeInt(it->second);
+		return;
+	}
+
+	std::uint32_t length = value.length();
+	appendInt(strings, length);
+	strings.append(value);
+	stringIndexes.emplace(std::move(key), stringCount);
+	writeInt(stringCount);
+	stringCount++;
+}
+
+void
+AstWriter::writeToken(const Token &token)
+{
+	writeByte(token.type);
+	writeInt(token.line);
+	writeString(token.lexeme);
+	if (token.type == NUMBER)
+	{
+		writeDouble(token.double_literal);
+	}
+	else if (token.type == IDENTIFIER || token.type == STRING)
+	{
+		writeString(encodeUtf8(token.interned->value));
+	}
+}
+
+void
+AstWriter::writeExpr(Expr *expr)
+{
+	if (expr)
+	{
+		expr->accept(static_cast<ExprVisitor<void> *>(this));
+	}
+	else
+	{
+		writeByte(static_cast<std::uint8_t>(NodeTag::NONE));
+	}
+}
+
+void
+AstWriter::writeStmt(Stmt *stmt)
+{
+	if (stmt)
+	{
+		stmt->accept(static_cast<StmtVisitor<void> *>(this));
+	}
+	else
+	{
+		writeByte(static_cast<std::uint8_t>(NodeTag::NONE));
+	}
+}
+
+void
+AstWriter::writeStatements(const std::vector<Stmt *> &statements)
+{
+	writeInt(statements.size());
+	for (const auto &statement : statements)
+	{
+		writeStmt(statement);
+	}
+}
+
+void
+AstWriter::visitAssignExpr(Assign *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::ASSIGN));
+	writeToken(expr->m_name);
+	writeExpr(expr->m_value);
+	writeSignedInt(expr->m_depth);
+	writeSignedInt(expr->m_slot);
+}
+
+void
+AstWriter::visitBlockStmt(Block *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::BLOCK));
+	writeSignedInt(stmt->m_locals);
+	writeStatements(stmt->m_statements);
+}
+
+void
+AstWriter::visitClassStmt(Class *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::CLASS));
+	writeToken(stmt->m_name);
+	writeExpr(stmt->m_superclass);
+	writeInt(stmt->m_methods.size());
+	for (const auto &method : stmt->m_methods)
+	{
+		writeStmt(method);
+	}
+}
+
+void
+AstWriter::visitBinaryExpr(Binary *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::BINARY));
+	writeExpr(expr->m_left);
+	writeToken(expr->m_operatorX);
+	writeExpr(expr->m_right);
+}
+
+void
+AstWriter::visitCallExpr(Call *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::CALL));
+	writeExpr(expr->m_callee);
+	writeToken(expr->m_paren);
+	writeInt(expr->m_arguments.size());
+	for (const auto &argument : expr->m_arguments)
+	{
+		writeExpr(argument);
+	}
+	// The Resolver only sets invoke to the callee.
+	writeByte(expr->m_invoke != nullptr);
+}
+
+void
+AstWriter::visitGetExpr(Get *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::GET));
+	writeExpr(expr->m_object);
+	writeToken(expr->m_name);
+}
+
+void
+AstWriter::visitExpressionStmt(Expression *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::EXPRESSION));
+	writeExpr(stmt->m_expression);
+}
+
+void
+AstWriter::visitForStmt(For *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::FOR));
+	writeSignedInt(stmt->m_locals);
+	writeStmt(stmt->m_initializer);
+	writeExpr(stmt->m_condition);
+	writeExpr(stmt->m_increment);
+	writeStmt(stmt->m_body);
+}
+
+void
+AstWriter::visitFunctionStmt(Function *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::FUNCTION));
+	writeToken(stmt->m_name);
+	writeInt(stmt->m_params.size());
+	for (const auto &param : stmt->m_params)
+	{
+		writeToken(param);
+	}
+	writeSignedInt(stmt->m_frameSize);
+	writeStatements(stmt->m_body);
+}
+
+void
+AstWriter::visitGroupingExpr(Grouping *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::GROUPING));
+	writeExpr(expr->m_expression);
+}
+
+void
+AstWriter::visitDoubleLiteralExpr(DoubleLiteral *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::DOUBLE_LITERAL));
+	writeDouble(expr->m_value);
+}
+
+void
+AstWriter::visitStringLiteralExpr(StringLiteral *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::STRING_LITERAL));
+	writeString(encodeUtf8(expr->m_value->value));
+}
+
+void
+AstWriter::visitBooleanLiteralExpr(BooleanLiteral *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::BOOLEAN_LITERAL));
+	writeByte(expr->m_value);
+}
+
+void
+AstWriter::visitNilLiteralExpr(NilLiteral *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::NIL_LITERAL));
+}
+
+void
+AstWriter::visitLogicalExpr(Logical *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::LOGICAL));
+	writeExpr(expr->m_left);
+	writeToken(expr->m_operatorX);
+	writeExpr(expr->m_right);
+}
+
+void
+AstWriter::visitSetExpr(Set *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::SET));
+	writeExpr(expr->m_object);
+	writeToken(expr->m_name);
+	writeExpr(expr->m_value);
+}
+
+void
+AstWriter::visitSuperExpr(Super *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::SUPER));
+	writeToken(expr->m_keyword);
+	writeToken(expr->m_method);
+	writeSignedInt(expr->m_depth);
+}
+
+void
+AstWriter::visitThisExpr(This *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::THIS));
+	writeToken(expr->m_keyword);
+	writeSignedInt(expr->m_depth);
+	writeSignedInt(expr->m_slot);
+}
+
+void
+AstWriter::visitIfStmt(If *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::IF));
+	writeExpr(stmt->m_condition);
+	writeStmt(stmt->m_thenBranch);
+	writeStmt(stmt->m_elseBranch);
+}
+
+void
+AstWriter::visitPrintStmt(Print *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::PRINT));
+	writeExpr(stmt->m_expression);
+}
+
+void
+AstWriter::visitReturnStmt(Return *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::RETURN));
+	writeToken(stmt->m_keyword);
+	writeExpr(stmt->m_value);
+}
+
+void
+AstWriter::visitUnaryExpr(Unary *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::UNARY));
+	writeToken(expr->m_operatorX);
+	writeExpr(expr->m_right);
+}
+
+void
+AstWriter::visitVariableExpr(Variable *expr)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::VARIABLE));
+	writeToken(expr->m_name);
+	writeSignedInt(expr->m_depth);
+	writeSignedInt(expr->m_slot);
+}
+
+void
+AstWriter::visitVarStmt(Var *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::VAR));
+	writeToken(stmt->m_name);
+	writeExpr(stmt->m_initializer);
+	writeSignedInt(stmt->m_slot);
+}
+
+void
+AstWriter::visitWhileStmt(While *stmt)
+{
+	writeByte(static_cast<std::uint8_t>(NodeTag::WHILE));
+	writeExpr(stmt->m_condition);
+	writeStmt(stmt->m_body);
+}
+
+AstReader::AstReader(std::string_view _data, Arena &_arena) :
+	data(_data),
+	arena(_arena)
+{
+}
+
+std::vector<Stmt *>
+AstReader::read()
+{
+	std::uint32_t stringCount = readInt();
+	for (std::uint32_t i = 0; i < stringCount; i++)
+	{
+		std::uint32_t length = readInt();
+		if (length > data.length() - position)
+		{
+			throw CacheError("string past end of cache");
+		}
+		strings.push_back(data.substr(position, length));
+		position += length;
+	}
+	interned.resize(stringCount);
+
+	std::vector<Stmt *> statements = readStatements();
+	if (position != data.length())
+	{
+		throw CacheError("data after end of cache");
+	}
+	return statements;
+}
+
+std::uint8_t
+AstReader::readByte()
+{
+	if (position >= data.length())
+	{
+		throw CacheError("unexpected end of cache");
+	}
+	return data[position++];
+}
+
+std::uint32_t
+AstReader::readInt()
+{
+	std::uint32_t value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		std::uint8_t byte = readByte();
+		value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	throw CacheError("number too long");
+}
+
+std::int32_t
+AstReader::readSignedInt()
+{
+	std::uint32_t value = readInt();
+	return static_cast<std::int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+double
+AstReader::readDouble()
+{
+	double value;
+	if (data.length() - position < sizeof(value))
+	{
+		throw CacheError("unexpected end of cache");
+	}
+	memcpy(&value, data.data() + position, sizeof(value));
+	position += sizeof(value);
+	return value;
+}
+
+std::uint32_t
+AstReader::readStringIndex()
+{
+	std::uint32_t index = readInt();
+	if (index >= strings.size())
+	{
+		throw CacheError("string index out of range");
+	}
+	return index;
+}
+
+std::shared_ptr<LoxString>
+AstReader::readInterned()
+{
+	std::uint32_t index = readStringIndex();
+	if (!interned[index])
+	{
+		interned[index] = StringTable::intern(decodeUtf8(strings[index]));
+	}
+	return interned[index];
+}
+
+/*
+ * Whether a statement defines a variable.
+ */
+static bool
+isDeclaration(const Stmt *stmt)
+{
+	return dynamic_cast<const Var *>(stmt) || dynamic_cast<const Function *>(stmt) ||
+		dynamic_cast<const Class *>(stmt);
+}
+
+/*
+ * Whether a lexeme is one the Scanner could have read as an identifier.
+ */
+static bool
+isIdentifier(std::string_view lexeme)
+{
+	if (lexeme.empty() || isdigit(static_cast<unsigned char>(lexeme[0])))
+	{
+		return false;
+	}
+	return std::all_of(lexeme.begin(), lexeme.end(), [](char c)
+		{
+			return isalnum(static_cast<unsigned char>(c)) || c == '_';
+		});
+}
+
+Token
+AstReader::readToken(std::initializer_list<TokenType> types)
+{
+	std::uint8_t byte = readByte();
+	if (byte > END_OF_FILE)
+	{
+		throw CacheError("invalid token type");
+	}
+	TokenType type = static_cast<TokenType>(byte);
+	if (std::find(types.begin(), types.end(), type) == types.end())
+	{
+		throw CacheError("unexpected token type");
+	}
+
+	int line = readInt();
+	std::string_view lexeme = strings[readStringIndex()];
+	if (type == NUMBER)
+	{
+		return Token(type, lexeme, readDouble(), line);
+	}
+
+	Token token(type, lexeme, line);
+	if (type == IDENTIFIER || type == STRING)
+	{
+		token.interned = readInterned();
+	}
+
+	// Names are printed in error messages, so they must be names the
+	// Scanner could have read, with the same interned string.
+	if (type == IDENTIFIER)
+	{
+		const std::wstring &name = token.interned->value;
+		if (!isIdentifier(lexeme) ||
+			!std::equal(lexeme.begin(), lexeme.end(), name.begin(), name.end()))
+		{
+			throw CacheError("invalid identifier");
+		}
+	}
+	return token;
+}
+
+std::vector<Stmt *>
+AstReader::readStatements()
+{
+	std::uint32_t count = readInt();
+	std::vector<Stmt *> statements;
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		statements.push_back(readRequiredStmt());
+	}
+	return statements;
+}
+
+AstReader::Scope *
+AstReader::environmentAt(int depth)
+{
+	for (auto it = scopes.rbegin(); it != scopes.rend(); it++)
+	{
+		if (it->kind == Scope::FRAME)
+		{
+			continue;
+		}
+		if (depth == 0)
+		{
+			return &*it;
+		}
+		depth--;
+	}
+	return nullptr;
+}
+
+AstReader::Scope *
+AstReader::currentFrame()
+{
+	for (auto it = scopes.rbegin(); it != scopes.rend(); it++)
+	{
+		if (it->kind == Scope::FRAME)
+		{
+			return &*it;
+		}
+		if (it->kind == Scope::FUNCTION || it->kind == Scope::METHOD)
+		{
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+void
+AstReader::checkVariable(int depth, int slot, bool assign)
+{
+	if (depth == STACK_DEPTH)
+	{
+		Scope *frame = currentFrame();
+		if (!frame || slot < 0 || static_cast<std::size_t>(slot) >= frame->size)
+		{
+			throw CacheError("stack slot out of range");
+		}
+		return;
+	}
+	if (depth == -1)
+	{
+		// A global.
+		return;
+	}
+
+	Scope *scope = (depth >= 0) ? environmentAt(depth) : nullptr;
+	if (!scope || slot < 0 || static_cast<std::size_t>(slot) >= scope->size)
+	{
+		throw CacheError("variable slot out of range");
+	}
+	// "super" and "this" are found by Super nodes without checking their
+	// types, so they cannot be assigned.
+	if (assign && (scope->kind == Scope::SUPER ||
+		(scope->kind == Scope::METHOD && slot == 0)))
+	{
+		throw CacheError("assignment to this or super");
+	}
+}
+
+void
+AstReader::defineVariable()
+{
+	// Variables outside any environment are globals, found by name.
+	Scope *scope = environmentAt(0);
+	if (scope)
+	{
+		scope->size++;
+	}
+}
+
+Expr *
+AstReader::readExpr()
+{
+	if (nesting >= MAX_NESTING)
+	{
+		throw CacheError("nodes nested too deeply");
+	}
+	nesting++;
+	Expr *expr = readExprNode();
+	nesting--;
+	return expr;
+}
+
+Stmt *
+AstReader::readStmt()
+{
+	if (nesting >= MAX_NESTING)
+	{
+		throw CacheError("nodes nested too deeply");
+	}
+	nesting++;
+	Stmt *stmt = readStmtNode();
+	nesting--;
+	return stmt;
+}
+
+Expr *
+AstReader::readRequiredExpr()
+{
+	Expr *expr = readExpr();
+	if (!expr)
+	{
+		throw CacheError("missing expression");
+	}
+	return expr;
+}
+
+Stmt *
+AstReader::readRequiredStmt()
+{
+	Stmt *stmt = readStmt();
+	if (!stmt)
+	{
+		throw CacheError("missing statement");
+	}
+	return stmt;
+}
+
+Stmt *
+AstReader::readBody()
+{
+	// The interpreter may skip a declaration in a branch, leaving later
+	// uses of its slot out of range.
+	Stmt *stmt = readRequiredStmt();
+	if (isDeclaration(stmt))
+	{
+		throw CacheError("declaration in a branch");
+	}
+	return stmt;
+}
+
+Expr *
+AstReader::readExprNode()
+{
+	NodeTag tag = static_cast<NodeTag>(readByte());
+	switch (tag)
+	{
+		case NodeTag::NONE:
+			return nullptr;
+		case NodeTag::ASSIGN:
+		{
+			Token name = readToken({IDENTIFIER});
+			Expr *value = readRequiredExpr();
+			Assign *expr = arena.make<Assign>(name, value);
+			expr->m_depth = readSignedInt();
+			expr->m_slot = readSignedInt();
+			checkVariable(expr->m_depth, expr->m_slot, true);
+			return expr;
+		}
+		case NodeTag::BINARY:
+		{
+			Expr *left = readRequiredExpr();
+			Token op = readToken({BANG_EQUAL, EQUAL_EQUAL, GREATER, GREATER_EQUAL,
+				LESS, LESS_EQUAL, MINUS, PLUS, SLASH, STAR});
+			Expr *right = readRequiredExpr();
+			return arena.make<Binary>(left, op, right);
+		}
+		case NodeTag::CALL:
+		{
+			Expr *callee = readRequiredExpr();
+			Token paren = readToken({RIGHT_PAREN});
+			std::uint32_t count = readInt();
+			std::vector<Expr *> arguments;
+			for (std::uint32_t i = 0; i < count; i++)
+			{
+				arguments.push_back(readRequiredExpr());
+			}
+			Call *expr = arena.make<Call>(callee, paren, arguments);
+			if (readByte())
+			{
+				expr->m_invoke = expect<Get>(callee);
+			}
+			return expr;
+		}
+		case NodeTag::GET:
+		{
+			Expr *object = readRequiredExpr();
+			Token name = readToken({IDENTIFIER});
+			return arena.make<Get>(object, name);
+		}
+		case NodeTag::GROUPING:
+			return arena.make<Grouping>(readRequiredExpr());
+		case NodeTag::DOUBLE_LITERAL:
+			return arena.make<DoubleLiteral>(readDouble());
+		case NodeTag::STRING_LITERAL:
+			return arena.make<StringLiteral>(readInterned());
+		case NodeTag::BOOLEAN_LITERAL:
+			return arena.make<BooleanLiteral>(readByte() != 0);
+		case NodeTag::NIL_LITERAL:
+			return arena.make<NilLiteral>();
+		case NodeTag::LOGICAL:
+		{
+			Expr *left = readRequiredExpr();
+			Token op = readToken({AND, OR});
+			Expr *right = readRequiredExpr();
+			return arena.make<Logical>(left, op, right);
+		}
+		case NodeTag::SET:
+		{
+			Expr *object = readRequiredExpr();
+			Token name = readToken({IDENTIFIER});
+			Expr *value = readRequiredExpr();
+			return arena.make<Set>(object, name, value);
+		}
+		case NodeTag::SUPER:
+		{
+			Token keyword = readToken({SUPER});
+			Token method = readToken({IDENTIFIER});
+			Super *expr = arena.make<Super>(keyword, method);
+			expr->m_depth = readSignedInt();
+			// The superclass is in the environment around the method,
+			// and "this" in slot 0 of the method's environment.
+			Scope *superScope = (expr->m_depth >= 1) ? environmentAt(expr->m_depth) : nullptr;
+			Scope *methodScope = superScope ? environmentAt(expr->m_depth - 1) : nullptr;
+			if (!superScope || superScope->kind != Scope::SUPER ||
+				!methodScope || methodScope->kind != Scope::METHOD)
+			{
+				throw CacheError("super outside a method of a subclass");
+			}
+			return expr;
+		}
+		case NodeTag::THIS:
+		{
+			This *expr = arena.make<This>(readToken({THIS}));
+			expr->m_depth = readSignedInt();
+			expr->m_slot = readSignedInt();
+			checkVariable(expr->m_depth, expr->m_slot, false);
+			return expr;
+		}
+		case NodeTag::UNARY:
+		{
+			Token op = readToken({BANG, MINUS});
+			Expr *right = readRequiredExpr();
+			return arena.make<Unary>(op, right);
+		}
+		case NodeTag::VARIABLE:
+		{
+			Variable *expr = arena.make<Variable>(readToken({IDENTIFIER}));
+			expr->m_depth = readSignedInt();
+			expr->m_slot = readSignedInt();
+			checkVariable(expr->m_depth, expr->m_slot, false);
+			return expr;
+		}
+		default:
+			throw CacheError("expected an expression");
+	}
+}
+
+Function *
+AstReader::readFunction(bool method)
+{
+	Token name = readToken({IDENTIFIER});
+	if (!method)
+	{
+		// Defined before its body, which may call it.
+		defineVariable();
+	}
+	std::uint32_t count = readInt();
+	std::vector<Token> params;
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		params.push_back(readToken({IDENTIFIER}));
+	}
+
+	// "this" and the parameters are stored in the frame or environment
+	// when the function is called.
+	std::size_t fixed = params.size() + (method ? 1 : 0);
+	int frameSize = readSignedInt();
+	if (frameSize < -1 || (frameSize >= 0 && static_cast<std::size_t>(frameSize) < fixed))
+	{
+		throw CacheError("invalid frame size");
+	}
+	if (frameSize >= 0)
+	{
+		scopes.push_back(Scope{Scope::FRAME, static_cast<std::size_t>(frameSize)});
+	}
+	else
+	{
+		scopes.push_back(Scope{method ? Scope::METHOD : Scope::FUNCTION, fixed});
+	}
+	std::size_t varsBefore = vars;
+	std::vector<Stmt *> body = readStatements();
+	scopes.pop_back();
+
+	// Each slot of a frame is "this", a parameter or a variable.
+	if (frameSize >= 0 && static_cast<std::size_t>(frameSize) > fixed + (vars - varsBefore))
+	{
+		throw CacheError("frame larger than its variables");
+	}
+	Function *stmt = arena.make<Function>(name, params, body);
+	stmt->m_frameSize = frameSize;
+	return stmt;
+}
+
+Stmt *
+AstReader::readStmtNode()
+{
+	NodeTag tag = static_cast<NodeTag>(readByte());
+	switch (tag)
+	{
+		case NodeTag::NONE:
+			return nullptr;
+		case NodeTag::BLOCK:
+		{
+			int locals = readSignedInt();
+			if (locals != 0)
+			{
+				scopes.push_back(Scope{Scope::BLOCK, 0});
+			}
+			Block *stmt = arena.make<Block>(readStatements());
+			if (locals != 0)
+			{
+				scopes.pop_back();
+			}
+
+			// Blocks have an environment for their declarations, except in
+			// a frame, where they are on the value stack.
+			int declarations = std::count_if(stmt->m_statements.begin(),
+				stmt->m_statements.end(), isDeclaration);
+			if (locals != (currentFrame() ? 0 : declarations))
+			{
+				throw CacheError("wrong number of locals in block");
+			}
+			stmt->m_locals = locals;
+			return stmt;
+		}
+		case NodeTag::CLASS:
+		{
+			if (currentFrame())
+			{
+				throw CacheError("class in a frame");
+			}
+			Token name = readToken({IDENTIFIER});
+			Variable *superclass = expect<Variable>(readExpr());
+			defineVariable();
+			if (superclass)
+			{
+				scopes.push_back(Scope{Scope::SUPER, 1});
+			}
+			std::uint32_t count = readInt();
+			std::vector<Function *> methods;
+			for (std::uint32_t i = 0; i < count; i++)
+			{
+				if (static_cast<NodeTag>(readByte()) != NodeTag::FUNCTION)
+				{
+					throw CacheError("expected a method");
+				}
+				methods.push_back(readFunction(true));
+			}
+			if (superclass)
+			{
+				scopes.pop_back();
+			}
+			return arena.make<Class>(name, superclass, methods);
+		}
+		case NodeTag::EXPRESSION:
+			return arena.make<Expression>(readRequiredExpr());
+		case NodeTag::FOR:
+		{
+			int locals = readSignedInt();
+			if (locals != 0)
+			{
+				scopes.push_back(Scope{Scope::BLOCK, 0});
+			}
+			Stmt *initializer = readStmt();
+			bool scoped = dynamic_cast<Var *>(initializer) != nullptr;
+			if ((initializer && !scoped && !dynamic_cast<Expression *>(initializer)) ||
+				locals != ((scoped && !currentFrame()) ? 1 : 0))
+			{
+				throw CacheError("invalid for initializer");
+			}
+			Expr *condition = readExpr();
+			Expr *increment = readExpr();
+			Stmt *body = readBody();
+			if (locals != 0)
+			{
+				scopes.pop_back();
+			}
+			For *stmt = arena.make<For>(initializer, condition, increment, body);
+			stmt->m_locals = locals;
+			return stmt;
+		}
+		case NodeTag::FUNCTION:
+			if (currentFrame())
+			{
+				throw CacheError("function in a frame");
+			}
+			return readFunction(false);
+		case NodeTag::IF:
+		{
+			Expr *condition = readRequiredExpr();
+			Stmt *thenBranch = readBody();
+			Stmt *elseBranch = readStmt();
+			if (isDeclaration(elseBranch))
+			{
+				throw CacheError("declaration in a branch");
+			}
+			return arena.make<If>(condition, thenBranch, elseBranch);
+		}
+		case NodeTag::PRINT:
+			return arena.make<Print>(readRequiredExpr());
+		case NodeTag::RETURN:
+		{
+			Token keyword = readToken({RETURN});
+			Expr *value = readExpr();
+			return arena.make<Return>(keyword, value);
+		}
+		case NodeTag::VAR:
+		{
+			Token name = readToken({IDENTIFIER});
+			Expr *initializer = readExpr();
+			Var *stmt = arena.make<Var>(name, initializer);
+			stmt->m_slot = readSignedInt();
+			vars++;
+
+			// Variables in a frame have a slot, and all others are defined
+			// in the environment after their initializer is evaluated.
+			Scope *frame = currentFrame();
+			if (frame)
+			{
+				if (stmt->m_slot < 0 || static_cast<std::size_t>(stmt->m_slot) >= frame->size)
+				{
+					throw CacheError("stack slot out of range");
+				}
+			}
+			else if (stmt->m_slot != -1)
+			{
+				throw CacheError("stack slot outside a frame");
+			}
+			else
+			{
+				defineVariable();
+			}
+			return stmt;
+		}
+		case NodeTag::WHILE:
+		{
+			Expr *condition = readRequiredExpr();
+			Stmt *body = readBody();
+			return arena.make<While>(condition, body);
+		}
+		default:
+			throw CacheError("expected a statement");
+	}
+}
+
+std::string
+AstCache::cachePath(const char *path)
+{
+	// Only scripts named *.lox are cached, so that the cache is never
+	// written over some other file named after the script.
+	std::string_view name(path);
+	std::string_view extension(".lox");
+	if (name.length() <= extension.length() ||
+		name.substr(name.length() - extension.length()) != extension)
+	{
+		return std::string();
+	}
+	return std::string(path) + "c";
+}
+
+bool
+AstCache::isReplaceable(const std::string &cacheFile)
+{
+	struct stat st;
+	if (lstat(cacheFile.c_str(), &st) != 0)
+	{
+		return errno == ENOENT;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		return false;
+	}
+
+	// A cache written by any version of lox1 can be replaced.
+	char start[sizeof(CACHE_MAGIC) + sizeof(std::uint32_t)];
+	FILE *f = fopen(cacheFile.c_str(), "rb");
+	if (!f)
+	{
+		return false;
+	}
+	bool isCache = (fread(start, 1, sizeof(start), f) == sizeof(start) &&
+		memcmp(start, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0);
+	fclose(f);
+	return isCache;
+}
+
+std::uint64_t
+AstCache::hash(std::string_view bytes)
+{
+	// 64-bit FNV-1a.
+	std::uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : bytes)
+	{
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+std::unique_ptr<SourceFile>
+AstCache::load(const char *path, const SourceFile &source, Arena &arena,
+	std::vector<Stmt *> &statements)
+{
+	std::string cacheFile = cachePath(path);
+	if (cacheFile.empty())
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+	std::unique_ptr<SourceFile> cache = SourceFile::map(cacheFile.c_str());
+	if (!cache)
+	{
+		return cache;
+	}
+
+	std::string_view bytes = cache->bytes();
+	CacheHeader header;
+	if (bytes.length() < sizeof(header))
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != CACHE_VERSION ||
+		header.sourceSize != source.bytes().length())
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+
+	// Only hash the script if it was touched since the cache was written.
+	struct stat st;
+	if (stat(path, &st) != 0)
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+	bool touched = (header.mtimeSeconds != st.st_mtim.tv_sec ||
+		header.mtimeNanoseconds != st.st_mtim.tv_nsec);
+	if (touched && header.sourceHash != hash(source.bytes()))
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+
+	// A cache damaged after it was written is not decoded.
+	std::string_view tree = bytes.substr(sizeof(header));
+	if (header.treeHash != hash(tree))
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+
+	try
+	{
+		AstReader reader(tree, arena);
+		statements = reader.read();
+	}
+	catch (const CacheError &)
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+
+	if (touched)
+	{
+		// Record the new time, so that the script is not hashed again.
+		save(path, source, statements);
+	}
+	return cache;
+}
+
+void
+AstCache::save(const char *path, const SourceFile &source,
+	const std::vector<Stmt *> &statements)
+{
+	std::string cacheFile = cachePath(path);
+	struct stat st;
+	if (cacheFile.empty() || !isReplaceable(cacheFile) || stat(path, &st) != 0)
+	{
+		return;
+	}
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.sourceSize = source.bytes().length();
+	header.mtimeSeconds = st.st_mtim.tv_sec;
+	header.mtimeNanoseconds = st.st_mtim.tv_nsec;
+	header.sourceHash = hash(source.bytes());
+
+	AstWriter writer;
+	std::string tree = writer.write(statements);
+	header.treeHash = hash(tree);
+
+	// Write a new file and rename it, so that a cache being read by
+	// another run is not changed under it. The new file is created
+	// exclusively, so that no existing file is truncated.
+	std::string tempFile = cacheFile + "." + std::to_string(getpid());
+	FILE *f = fopen(tempFile.c_str(), "wbx");
+	if (!f)
+	{
+		return;
+	}
+	bool written = (fwrite(&header, sizeof(header), 1, f) == 1 &&
+		fwrite(tree.data(), 1, tree.size(), f) == tree.size());
+	if (fclose(f) != 0 || !written)
+	{
+		std::remove(tempFile.c_str());
+		return;
+	}
+	if (std::rename(tempFile.c_str(), cacheFile.c_str()) != 0)
+	{
+		std::remove(tempFile.c_str());
+	}
+}
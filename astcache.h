@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "token.h"
+#include "expr.h"
+#include "stmt.h"
+#include "arena.h"
+#include "sourcefile.h"
+
+/*
+ * Thrown when a cache file cannot be read.
+ */
+class CacheError : public std::runtime_error
+{
+public:
+	CacheError(const std::string &message) :
+		std::runtime_error(message)
+	{
+	}
+};
+
+/**
+ * Writes a resolved syntax tree in the binary format of the cache.
+ *
+ * Lexemes, names and string values are written once each to a table of
+ * UTF-8 strings, and tokens and nodes refer to them by index. Nodes are
+ * written in prefix order, each starting with a tag for its type. The
+ * number of locals of a block or the frame size of a function is written
+ * before its children, so that the reader can check them.
+ */
+class AstWriter : public ExprVisitor<void>, public StmtVisitor<void>
+{
+public:
+	/*
+	 * The string table followed by the statements.
+	 */
+	std::string write(const std::vector<Stmt *> &statements);
+
+	void visitAssignExpr(Assign *expr);
+
+	void visitBlockStmt(Block *stmt);
+
+	void visitClassStmt(Class *stmt);
+
+	void visitBinaryExpr(Binary *expr);
+
+	void visitCallExpr(Call *expr);
+
+	void visitGetExpr(Get *expr);
+
+	void visitExpressionStmt(Expression *stmt);
+
+	void visitForStmt(For *stmt);
+
+	void visitFunctionStmt(Function *stmt);
+
+	void visitGroupingExpr(Grouping *expr);
+
+	void visitDoubleLiteralExpr(DoubleLiteral *expr);
+
+	void visitStringLiteralExpr(StringLiteral *expr);
+
+	void visitBooleanLiteralExpr(BooleanLiteral *expr);
+
+	void visitNilLiteralExpr(NilLiteral *expr);
+
+	void visitLogicalExpr(Logical *expr);
+
+	void visitSetExpr(Set *expr);
+
+	void visitSuperExpr(Super *expr);
+
+	void visitThisExpr(This *expr);
+
+	void visitIfStmt(If *stmt);
+
+	void visitPrintStmt(Print *stmt);
+
+	void visitReturnStmt(Return *stmt);
+
+	void visitUnaryExpr(Unary *expr);
+
+	void visitVariableExpr(Variable *expr);
+
+	void visitVarStmt(Var *stmt);
+
+	void visitWhileStmt(While *stmt);
+
+private:
+	std::string strings;
+
+	std::string nodes;
+
+	std::uint32_t stringCount = 0;
+
+	std::unordered_map<std::string, std::uint32_t> stringIndexes;
+
+	void writeByte(std::uint8_t value);
+
+	void writeInt(std::uint32_t value);
+
+	void writeSignedInt(std::int32_t value);
+
+	void writeDouble(double value);
+
+	void writeString(std::string_view value);
+
+	void writeToken(const Token &token);
+
+	void writeExpr(Expr *expr);
+
+	void writeStmt(Stmt *stmt);
+
+	void writeStatements(const std::vector<Stmt *> &statements);
+};
+
+/**
+ * Reads a syntax tree written by AstWriter, creating its nodes in an
+ * Arena. Lexemes are views into the data read, which must be kept as
+ * long as the tree.
+ *
+ * The tree is checked as it is read, so that a damaged cache throws
+ * CacheError rather than running a tree that the interpreter would read
+ * out of bounds: nodes and tokens must be those the grammar allows, and
+ * each resolved variable must be in a scope that will have it defined.
+ */
+class AstReader
+{
+public:
+	AstReader(std::string_view _data, Arena &_arena);
+
+	std::vector<Stmt *> read();
+
+private:
+	std::string_view data;
+
+	std::size_t position = 0;
+
+	Arena &arena;
+
+	std::vector<std::string_view> strings;
+
+	/*
+	 * Interned strings, created on first use.
+	 */
+	std::vector<std::shared_ptr<LoxString>> interned;
+
+	/*
+	 * An environment or value stack frame that the interpreter creates
+	 * to run the nodes being read, so that the variables the nodes refer
+	 * to are checked to be there.
+	 */
+	class Scope
+	{
+	public:
+		enum Kind
+		{
+			BLOCK,
+			FUNCTION,
+			METHOD,
+			SUPER,
+			FRAME
+		};
+
+		Kind kind;
+
+		/*
+		 * Variables defined so far in an environment, or the size of a
+		 * frame.
+		 */
+		std::size_t size;
+	};
+
+	std::vector<Scope> scopes;
+
+	/*
+	 * Nodes being read, so that a deeply nested tree cannot overflow the
+	 * stack.
+	 */
+	std::size_t nesting = 0;
+
+	/*
+	 * Var statements read, to check the size of frames.
+	 */
+	std::size_t vars = 0;
+
+	std::uint8_t readByte();
+
+	std::uint32_t readInt();
+
+	std::int32_t readSignedInt();
+
+	double readDouble();
+
+	std::uint32_t readStringIndex();
+
+	std::shared_ptr<LoxString> readInterned();
+
+	/*
+	 * Read a token, which must be of one of the types given.
+	 */
+	Token readToken(std::initializer_list<TokenType> types);
+
+	/*
+	 * Read a node, or nullptr for a node that is not there.
+	 */
+	Expr *readExpr();
+
+	Stmt *readStmt();
+
+	/*
+	 * Read a node that the grammar requires to be there.
+	 */
+	Expr *readRequiredExpr();
+
+	Stmt *readRequiredStmt();
+
+	/*
+	 * Read the body or branch of a loop or if, which cannot declare a
+	 * variable.
+	 */
+	Stmt *readBody();
+
+	Expr *readExprNode();
+
+	Stmt *readStmtNode();
+
+	std::vector<Stmt *> readStatements();
+
+	Function *readFunction(bool method);
+
+	/*
+	 * The environment depth levels out, or nullptr if there is none.
+	 */
+	Scope *environmentAt(int depth);
+
+	/*
+	 * The frame of the function being read, or nullptr if it has none.
+	 */
+	Scope *currentFrame();
+
+	/*
+	 * Check that a resolved variable is defined where the interpreter
+	 * will look for it.
+	 */
+	void checkVariable(int depth, int slot, bool assign);
+
+	/*
+	 * Count a variable defined in the current environment.
+	 */
+	void defineVariable();
+
+	/*
+	 * Check that a node read is of the type its parent requires.
+	 */
+	template <class T, class Base>
+	T *
+	expect(Base *node)
+	{
+		T *result = dynamic_cast<T *>(node);
+		if (node && !result)
+		{
+			throw CacheError("unexpected node type");
+		}
+		return result;
+	}
+};
+
+/**
+ * Cache of the resolved syntax tree of a script, so that scripts that
+ * have not changed are run without scanning, parsing and resolving them
+ * again.
+ *
+ * The cache of script.lox is written next to it as script.loxc, and
+ * scripts with other names are not cached. An existing script.loxc is
+ * only replaced if it is a cache. The cache records the size,
+ * modification time and a hash of the script. It is used if the size
+ * and modification time match, or if the modification time changed but
+ * the hash still matches. A hash of the tree is checked before it is
+ * read, to ignore a cache damaged on disk.
+ */
+class AstCache
+{
+public:
+	/*
+	 * Load the cached syntax tree of a script into arena. Returns the
+	 * mapped cache file, which the tree's tokens refer to, or nullptr
+	 * if there is no valid cache.
+	 */
+	static std::unique_ptr<SourceFile> load(const char *path,
+		const SourceFile &source, Arena &arena, std::vector<Stmt *> &statements);
+
+	/*
+	 * Write the cache of a script that was parsed and resolved without
+	 * errors. Failure to write it is ignored.
+	 */
+	static void save(const char *path, const SourceFile &source,
+		const std::vector<Stmt *> &statements);
+
+private:
+	/*
+	 * The cache file of a script, or an empty string if it is not
+	 * cached.
+	 */
+	static std::string cachePath(const char *path);
+
+	/*
+	 * Whether a cache file is missing or was written by lox1, so that
+	 * it can be replaced.
+	 */
+	static bool isReplaceable(const std::string &cacheFile);
+
+	static std::uint64_t hash(std::string_view bytes);
+};
@@ -5,141 +5,262 @@
 #include "astprinter.h"
 
 std::wstring
-AstPrinter::print(std::shared_ptr<Expr> expr)
+AstPrinter::print(Expr *expr)
 {
-	std::any result = expr->accept(this);
-	return std::any_cast<std::wstring>(result);
+	return expr->accept(static_cast<ExprVisitor<std::wstring> *>(this));
 }
 
-std::any
-AstPrinter::visitAssignExpr(std::shared_ptr<Assign> expr)
+std::wstring
+AstPrinter::print(Stmt *stmt)
+{
+	return stmt->accept(static_cast<StmtVisitor<std::wstring> *>(this));
+}
+
+std::wstring
+AstPrinter::visitBlockStmt(Block *stmt)
+{
+	return parenthesize(L"block", stmt->m_statements);
+}
+
+std::wstring
+AstPrinter::visitClassStmt(Class *stmt)
+{
+	std::wostringstream os;
+	os << "(class " << stmt->m_name.text();
+	if (stmt->m_superclass)
+	{
+		os << " < " << print(stmt->m_superclass);
+	}
+	for (const auto &method : stmt->m_methods)
+	{
+		os << " " << print(method);
+	}
+	os << ")";
+	return os.str();
+}
+
+std::wstring
+AstPrinter::visitExpressionStmt(Expression *stmt)
+{
+	return parenthesize(L";", stmt->m_expression);
+}
+
+std::wstring
+AstPrinter::visitForStmt(For *stmt)
 {
+	// A clause that is left out is printed as "-".
 	std::wostringstream os;
-	os << "assign " << expr->m_name->lexeme;
+	os << "(for " << (stmt->m_initializer ? print(stmt->m_initializer) : L"-") <<
+		" " << (stmt->m_condition ? print(stmt->m_condition) : L"-") <<
+		" " << (stmt->m_increment ? print(stmt->m_increment) : L"-") <<
+		" " << print(stmt->m_body) << ")";
+	return os.str();
+}
+
+std::wstring
+AstPrinter::visitFunctionStmt(Function *stmt)
+{
+	std::wostringstream os;
+	os << "fun " << stmt->m_name.text() << " (";
+	for (std::size_t i = 0; i < stmt->m_params.size(); i++)
+	{
+		if (i > 0)
+		{
+			os << " ";
+		}
+		os << stmt->m_params.at(i).text();
+	}
+	os << ")";
+	return parenthesize(os.str(), stmt->m_body);
+}
+
+std::wstring
+AstPrinter::visitIfStmt(If *stmt)
+{
+	std::wostringstream os;
+	os << "(if " << print(stmt->m_condition) << " " << print(stmt->m_thenBranch);
+	if (stmt->m_elseBranch)
+	{
+		os << " " << print(stmt->m_elseBranch);
+	}
+	os << ")";
+	return os.str();
+}
+
+std::wstring
+AstPrinter::visitPrintStmt(Print *stmt)
+{
+	return parenthesize(L"print", stmt->m_expression);
+}
+
+std::wstring
+AstPrinter::visitReturnStmt(Return *stmt)
+{
+	if (stmt->m_value)
+	{
+		return parenthesize(L"return", stmt->m_value);
+	}
+	return std::wstring(L"(return)");
+}
+
+std::wstring
+AstPrinter::visitVarStmt(Var *stmt)
+{
+	if (stmt->m_initializer)
+	{
+		return parenthesize(L"var " + stmt->m_name.text(), stmt->m_initializer);
+	}
+	return L"(var " + stmt->m_name.text() + L")";
+}
+
+std::wstring
+AstPrinter::visitWhileStmt(While *stmt)
+{
+	std::wostringstream os;
+	os << "(while " << print(stmt->m_condition) << " " << print(stmt->m_body) << ")";
+	return os.str();
+}
+
+std::wstring
+AstPrinter::visitAssignExpr(Assign *expr)
+{
+	std::wostringstream os;
+	os << "assign " << expr->m_name.text();
 	return parenthesize(os.str(), expr->m_value);
 }
 
-std::any
-AstPrinter::visitBinaryExpr(std::shared_ptr<Binary> expr)
+std::wstring
+AstPrinter::visitBinaryExpr(Binary *expr)
 {
-	return parenthesize(expr->m_operatorX->lexeme,
+	return parenthesize(expr->m_operatorX.text(),
 		expr->m_left,
 		expr->m_right);
 }
 
-std::any
-AstPrinter::visitCallExpr(std::shared_ptr<Call> expr)
+std::wstring
+AstPrinter::visitCallExpr(Call *expr)
 {
 	std::wostringstream os;
-	os << std::any_cast<std::wstring>(parenthesize(L"call", expr->m_callee));
+	os << parenthesize(L"call", expr->m_callee);
 	for (const auto &argument : expr->m_arguments)
 	{
-		os << std::any_cast<std::wstring>(parenthesize(std::wstring(), argument));
+		os << parenthesize(std::wstring(), argument);
 	}
 	return os.str();
 }
 
-std::any
-AstPrinter::visitGetExpr(std::shared_ptr<Get> expr)
+std::wstring
+AstPrinter::visitGetExpr(Get *expr)
 {
 	std::wostringstream os;
-	os << "assign " << expr->m_name->lexeme;
+	os << "get " << expr->m_name.text();
 	return parenthesize(os.str(), expr->m_object);
 }
 
-std::any
-AstPrinter::visitGroupingExpr(std::shared_ptr<Grouping> expr)
+std::wstring
+AstPrinter::visitGroupingExpr(Grouping *expr)
 {
 	std::wstring grouping(L"group");
 	return parenthesize(grouping, expr->m_expression);
 }
 
-std::any
-AstPrinter::visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr)
+std::wstring
+AstPrinter::visitDoubleLiteralExpr(DoubleLiteral *expr)
 {
 	std::wostringstream os;
 	os << expr->m_value;
 	return os.str();
 }
 
-std::any
-AstPrinter::visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr)
+std::wstring
+AstPrinter::visitStringLiteralExpr(StringLiteral *expr)
 {
-	return expr->m_value;
+	return L"\"" + expr->m_value->value + L"\"";
 }
 
-std::any
-AstPrinter::visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr)
+std::wstring
+AstPrinter::visitBooleanLiteralExpr(BooleanLiteral *expr)
 {
 	return expr->m_value ? std::wstring(L"true") : std::wstring(L"false");
 }
 
-std::any
-AstPrinter::visitLogicalExpr(std::shared_ptr<Logical> expr)
+std::wstring
+AstPrinter::visitLogicalExpr(Logical *expr)
 {
-	return parenthesize(expr->m_operatorX->lexeme, expr->m_left, expr->m_right);
+	return parenthesize(expr->m_operatorX.text(), expr->m_left, expr->m_right);
 }
 
-std::any
-AstPrinter::visitSetExpr(std::shared_ptr<Set> expr)
+std::wstring
+AstPrinter::visitSetExpr(Set *expr)
 {
 	std::wostringstream os;
-	os << std::any_cast<std::wstring>(parenthesize(L"set", expr->m_object));
-	os << std::any_cast<std::wstring>(parenthesize(expr->m_name->lexeme, expr->m_value));
+	os << parenthesize(L"set", expr->m_object);
+	os << parenthesize(expr->m_name.text(), expr->m_value);
 	return os.str();
 }
 
 
-std::any
-AstPrinter::visitSuperExpr(std::shared_ptr<Super> expr)
+std::wstring
+AstPrinter::visitSuperExpr(Super *expr)
 {
-	return expr->m_keyword->lexeme + L"." + expr->m_method->lexeme;
+	return expr->m_keyword.text() + L"." + expr->m_method.text();
 }
 
-std::any
-AstPrinter::visitThisExpr(std::shared_ptr<This> expr)
+std::wstring
+AstPrinter::visitThisExpr(This *expr)
 {
-	return expr->m_keyword->lexeme;
+	return expr->m_keyword.text();
 }
 
-std::any
-AstPrinter::visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr)
+std::wstring
+AstPrinter::visitNilLiteralExpr(NilLiteral *expr)
 {
 	return std::wstring(L"nil");
 }
 
-std::any
-AstPrinter::visitUnaryExpr(std::shared_ptr<Unary> expr)
+std::wstring
+AstPrinter::visitUnaryExpr(Unary *expr)
+{
+	return parenthesize(expr->m_operatorX.text(), expr->m_right);
+}
+
+std::wstring
+AstPrinter::visitVariableExpr(Variable *expr)
 {
-	return parenthesize(expr->m_operatorX->lexeme, expr->m_right);
+	return expr->m_name.text();
 }
 
-std::any
-AstPrinter::visitVariableExpr(std::shared_ptr<Variable> expr)
+std::wstring
+AstPrinter::parenthesize(const std::wstring &name,
+	Expr *expr1)
 {
-	return expr->m_name->lexeme;
+	std::wostringstream os;
+	os << "(" << name << " " << print(expr1) << ")";
+	return os.str();
 }
 
-std::any
+std::wstring
 AstPrinter::parenthesize(const std::wstring &name,
-	std::shared_ptr<Expr> expr1)
+	Expr *expr1,
+	Expr *expr2)
 {
 	std::wostringstream os;
-	std::any result = expr1->accept(this);
-	os << "(" << name << " " << std::any_cast<std::wstring>(result) << ")";
+	std::wstring result1 = print(expr1);
+	std::wstring result2 = print(expr2);
+	os << "(" << name << " " << result1 << " " << result2 << ")";
 	return os.str();
 }
 
-std::any
+std::wstring
 AstPrinter::parenthesize(const std::wstring &name,
-	std::shared_ptr<Expr> expr1,
-	std::shared_ptr<Expr> expr2)
+	const std::vector<Stmt *> &statements)
 {
 	std::wostringstream os;
-	std::any result1 = expr1->accept(this);
-	std::any result2 = expr2->accept(this);
-	os << "(" << name << " " <<
-		std::any_cast<std::wstring>(result1) << " " <<
-		std::any_cast<std::wstring>(result2) << ")";
+	os << "(" << name;
+	for (const auto &statement : statements)
+	{
+		os << " " << print(statement);
+	}
+	os << ")";
 	return os.str();
 }
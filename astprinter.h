@@ -5,45 +5,71 @@
 
 #include "token.h"
 #include "expr.h"
+#include "stmt.h"
 
-class AstPrinter : public ExprVisitor
+class AstPrinter : public ExprVisitor<std::wstring>, public StmtVisitor<std::wstring>
 {
 public:
-	std::wstring print(std::shared_ptr<Expr> expr);
+	std::wstring print(Expr *expr);
 
-	std::any visitAssignExpr(std::shared_ptr<Assign> expr);
+	std::wstring print(Stmt *stmt);
 
-	std::any visitBinaryExpr(std::shared_ptr<Binary> expr);
+	std::wstring visitBlockStmt(Block *stmt);
 
-	std::any visitCallExpr(std::shared_ptr<Call> expr);
+	std::wstring visitClassStmt(Class *stmt);
 
-	std::any visitGetExpr(std::shared_ptr<Get> expr);
+	std::wstring visitExpressionStmt(Expression *stmt);
 
-	std::any visitGroupingExpr(std::shared_ptr<Grouping> expr);
+	std::wstring visitForStmt(For *stmt);
 
-	std::any visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr);
+	std::wstring visitFunctionStmt(Function *stmt);
 
-	std::any visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr);
+	std::wstring visitIfStmt(If *stmt);
 
-	std::any visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr);
+	std::wstring visitPrintStmt(Print *stmt);
 
-	std::any visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr);
+	std::wstring visitReturnStmt(Return *stmt);
 
-	std::any visitLogicalExpr(std::shared_ptr<Logical> expr);
+	std::wstring visitVarStmt(Var *stmt);
 
-	std::any visitSetExpr(std::shared_ptr<Set> expr);
+	std::wstring visitWhileStmt(While *stmt);
 
-	std::any visitSuperExpr(std::shared_ptr<Super> expr);
+	std::wstring visitAssignExpr(Assign *expr);
 
-	std::any visitThisExpr(std::shared_ptr<This> expr);
+	std::wstring visitBinaryExpr(Binary *expr);
 
-	std::any visitUnaryExpr(std::shared_ptr<Unary> expr);
+	std::wstring visitCallExpr(Call *expr);
 
-	std::any visitVariableExpr(std::shared_ptr<Variable> expr);
+	std::wstring visitGetExpr(Get *expr);
 
-	std::any parenthesize(const std::wstring &name, std::shared_ptr<Expr> expr1);
+	std::wstring visitGroupingExpr(Grouping *expr);
 
-	std::any parenthesize(const std::wstring &name,
-		std::shared_ptr<Expr> expr1,
-		std::shared_ptr<Expr> expr2);
+	std::wstring visitDoubleLiteralExpr(DoubleLiteral *expr);
+
+	std::wstring visitStringLiteralExpr(StringLiteral *expr);
+
+	std::wstring visitBooleanLiteralExpr(BooleanLiteral *expr);
+
+	std::wstring visitNilLiteralExpr(NilLiteral *expr);
+
+	std::wstring visitLogicalExpr(Logical *expr);
+
+	std::wstring visitSetExpr(Set *expr);
+
+	std::wstring visitSuperExpr(Super *expr);
+
+	std::wstring visitThisExpr(This *expr);
+
+	std::wstring visitUnaryExpr(Unary *expr);
+
+	std::wstring visitVariableExpr(Variable *expr);
+
+	std::wstring parenthesize(const std::wstring &name, Expr *expr1);
+
+	std::wstring parenthesize(const std::wstring &name,
+		const std::vector<Stmt *> &statements);
+
+	std::wstring parenthesize(const std::wstring &name,
+		Expr *expr1,
+		Expr *expr2);
 };
@@ -6,20 +6,22 @@
 #include "token.h"
 #include "expr.h"
 #include "astprinter.h"
+#include "arena.h"
 
 int
 main(int argc, char *argv[])
 {
-	auto d1 = std::make_shared<DoubleLiteral>(123);
-	auto t1 = std::make_shared<Token>(TokenType::MINUS, L"-", 1);
-	auto u1 = std::make_shared<Unary>(t1, d1);
+	Arena arena;
+	auto d1 = arena.make<DoubleLiteral>(123);
+	Token t1(TokenType::MINUS, "-", 1);
+	auto u1 = arena.make<Unary>(t1, d1);
 
-	auto t2 = std::make_shared<Token>(TokenType::STAR, L"*", 1);
+	Token t2(TokenType::STAR, "*", 1);
 
-	auto d2 = std::make_shared<DoubleLiteral>(45.67);
-	auto g = std::make_shared<Grouping>(d2);
+	auto d2 = arena.make<DoubleLiteral>(45.67);
+	auto g = arena.make<Grouping>(d2);
 
-	auto expression = std::make_shared<Binary>(
+	auto expression = arena.make<Binary>(
 		u1,
 		t2,
 		g);
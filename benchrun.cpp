@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * One run of a script, with its wall time and peak resident set size.
+ */
+class Run
+{
+public:
+	double milliseconds = 0;
+
+	long maxRssKb = 0;
+};
+
+/*
+ * Run lox1 on a script with an engine, discarding its output. Returns
+ * false if it could not be run or did not succeed.
+ */
+static bool
+runScript(const char *lox1, const std::string &engine, const char *script, Run &run)
+{
+	auto start = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		return false;
+	}
+	if (pid == 0)
+	{
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+		std::string engineOption = "--engine=" + engine;
+		execl(lox1, lox1, engineOption.c_str(), "--no-cache", script, (char *)nullptr);
+		_exit(127);
+	}
+
+	int status = 0;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) != pid)
+	{
+		return false;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	run.milliseconds = elapsed.count();
+	run.maxRssKb = usage.ru_maxrss;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/*
+ * Benchmark runner for "make bench": run each script a number of times
+ * with each engine, and write the median wall time and the peak resident
+ * set size to a tab-separated file, so that results can be compared
+ * between commits.
+ */
+int
+main(int argc, char *argv[])
+{
+	if (argc < 5)
+	{
+		std::wcerr << "Usage: " << argv[0] << " lox1 runs output.tsv script ..." << std::endl;
+		exit(64);
+	}
+	const char *lox1 = argv[1];
+	int runs = std::max(1, atoi(argv[2]));
+	std::ofstream output(argv[3]);
+	if (!output)
+	{
+		std::wcerr << "Cannot write " << argv[3] << std::endl;
+		exit(73);
+	}
+
+	output << "benchmark\tengine\truns\tmedian_ms\tpeak_rss_kb" << std::endl;
+	int failures = 0;
+	for (int i = 4; i < argc; i++)
+	{
+		std::string name(argv[i]);
+		name = name.substr(name.find_last_of('/') + 1);
+		name = name.substr(0, name.find_last_of('.'));
+
+		for (const std::string engine : {"tree", "vm"})
+		{
+			std::vector<double> times;
+			long peakRssKb = 0;
+			bool ok = true;
+			for (int r = 0; r < runs && ok; r++)
+			{
+				Run run;
+				ok = runScript(lox1, engine, argv[i], run);
+				times.push_back(run.milliseconds);
+				peakRssKb = std::max(peakRssKb, run.maxRssKb);
+			}
+			if (!ok)
+			{
+				std::wcerr << argv[i] << " failed with --engine=" <<
+					engine.c_str() << std::endl;
+				failures++;
+				continue;
+			}
+
+			std::sort(times.begin(), times.end());
+			double median = (runs % 2 == 1) ? times[runs / 2] :
+				(times[runs / 2 - 1] + times[runs / 2]) / 2;
+			output << name << "\t" << engine << "\t" << runs << "\t" <<
+				std::fixed << std::setprecision(1) << median << "\t" <<
+				peakRssKb << std::endl;
+			std::wcout << std::left << std::setw(20) << name.c_str() <<
+				std::setw(6) << engine.c_str() << std::right <<
+				std::fixed << std::setprecision(1) << std::setw(10) << median <<
+				" ms" << std::setw(10) << peakRssKb << " KB" << std::endl;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#include "chunk.h"
+
+void
+Chunk::write(uint8_t byte, int line)
+{
+	code.push_back(byte);
+	lines.push_back(line);
+}
+
+std::size_t
+Chunk::addConstant(const Value &value)
+{
+	constants.push_back(value);
+	return constants.size() - 1;
+}
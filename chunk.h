@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "value.h"
+
+/*
+ * Instructions of the bytecode virtual machine.
+ * Operands follow the opcode: a "byte" operand is one byte, a "short"
+ * operand is two bytes, most significant byte first.
+ */
+enum OpCode : uint8_t
+{
+	OP_CONSTANT,		// short: constant index
+	OP_NIL,
+	OP_TRUE,
+	OP_FALSE,
+	OP_POP,
+	OP_GET_LOCAL,		// byte: stack slot
+	OP_SET_LOCAL,		// byte: stack slot
+	OP_GET_GLOBAL,		// short: global variable index
+	OP_DEFINE_GLOBAL,	// short: global variable index
+	OP_SET_GLOBAL,		// short: global variable index
+	OP_GET_UPVALUE,		// byte: upvalue index
+	OP_SET_UPVALUE,		// byte: upvalue index
+	OP_GET_PROPERTY,	// short: constant index of name
+	OP_SET_PROPERTY,	// short: constant index of name
+	OP_GET_SUPER,		// short: constant index of name
+	OP_EQUAL,
+	OP_NOT_EQUAL,
+	OP_GREATER,
+	OP_GREATER_EQUAL,
+	OP_LESS,
+	OP_LESS_EQUAL,
+	OP_ADD,
+	OP_SUBTRACT,
+	OP_MULTIPLY,
+	OP_DIVIDE,
+	OP_NOT,
+	OP_NEGATE,
+	OP_PRINT,
+	OP_JUMP,		// short: forward offset
+	OP_JUMP_IF_FALSE,	// short: forward offset
+	OP_LOOP,		// short: backward offset
+	OP_CALL,		// byte: argument count
+	OP_INVOKE,		// short: constant index of name, byte: argument count
+	OP_SUPER_INVOKE,	// short: constant index of name, byte: argument count
+	OP_CLOSURE,		// short: constant index of function, then byte pairs
+	OP_CLOSE_UPVALUE,
+	OP_RETURN,
+	OP_CLASS,		// short: constant index of name
+	OP_INHERIT,
+	OP_METHOD		// short: constant index of name
+};
+
+/**
+ * A sequence of bytecode with its constants, compiled from one function.
+ */
+class Chunk
+{
+public:
+	std::vector<uint8_t> code;
+
+	/*
+	 * Source line of each byte in code, for runtime errors.
+	 */
+	std::vector<int> lines;
+
+	std::vector<Value> constants;
+
+	void write(uint8_t byte, int line);
+
+	std::size_t addConstant(const Value &value);
+};
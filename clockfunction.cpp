@@ -1,22 +1,79 @@
 #include <chrono>
+#include <ctime>
 
 #include "clockfunction.h"
 
+ClockFunction::ClockFunction() :
+	LoxCallable(ObjectType::NATIVE)
+{
+}
+
 std::size_t
 ClockFunction::arity()
 {
 	return 0;
 }
 
-std::shared_ptr<Expr>
-ClockFunction::call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments)
+Value
+ClockFunction::call(Interpreter *interpreter, const std::vector<Value> &arguments)
+{
+	// steady_clock does not jump when the system time is set.
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now().time_since_epoch();
+	return Value(seconds.count());
+}
+
+std::wstring
+ClockFunction::toString()
+{
+	return L"<native fn>";
+}
+
+NanoTimeFunction::NanoTimeFunction() :
+	LoxCallable(ObjectType::NATIVE)
+{
+}
+
+std::size_t
+NanoTimeFunction::arity()
+{
+	return 0;
+}
+
+Value
+NanoTimeFunction::call(Interpreter *interpreter, const std::vector<Value> &arguments)
+{
+	// Exact in a double for 104 days of uptime.
+	std::chrono::nanoseconds nanoseconds = std::chrono::steady_clock::now().time_since_epoch();
+	return Value(static_cast<double>(nanoseconds.count()));
+}
+
+std::wstring
+NanoTimeFunction::toString()
+{
+	return L"<native fn>";
+}
+
+CpuTimeFunction::CpuTimeFunction() :
+	LoxCallable(ObjectType::NATIVE)
+{
+}
+
+std::size_t
+CpuTimeFunction::arity()
+{
+	return 0;
+}
+
+Value
+CpuTimeFunction::call(Interpreter *interpreter, const std::vector<Value> &arguments)
 {
-	auto seconds = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	return std::make_shared<DoubleLiteral>(seconds);
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return Value(now.tv_sec + now.tv_nsec / 1e9);
 }
 
-std::any
-ClockFunction::accept(ExprVisitor *visitor)
+std::wstring
+CpuTimeFunction::toString()
 {
-	return std::make_shared<NilLiteral>();
+	return L"<native fn>";
 }
@@ -4,13 +4,51 @@
 
 /**
  * Built-in clock() function from 10.2.1.
+ *
+ * Returns the seconds elapsed on a monotonic clock, with a fraction, so
+ * that a script can time sections shorter than a second. Only
+ * differences between two calls are meaningful.
  */
 class ClockFunction : public LoxCallable
 {
 public:
+	ClockFunction();
+
+	std::size_t arity();
+
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments);
+
+	std::wstring toString();
+};
+
+/**
+ * Built-in nanotime() function, the nanoseconds elapsed on the same
+ * monotonic clock as clock().
+ */
+class NanoTimeFunction : public LoxCallable
+{
+public:
+	NanoTimeFunction();
+
+	std::size_t arity();
+
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments);
+
+	std::wstring toString();
+};
+
+/**
+ * Built-in cpuTime() function, the seconds of processor time used by
+ * the interpreter, with a fraction.
+ */
+class CpuTimeFunction : public LoxCallable
+{
+public:
+	CpuTimeFunction();
+
 	std::size_t arity();
 
-	std::shared_ptr<Expr> call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments);
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments);
 
-	std::any accept(ExprVisitor *visitor);
+	std::wstring toString();
 };
@@ -0,0 +1,783 @@
+#include <limits>
+
+#include "compiler.h"
+#include "vm.h"
+#include "lox.h"
+
+FunctionCompiler::FunctionCompiler(FunctionType _type) :
+	function(std::make_shared<VmFunction>()),
+	type(_type)
+{
+}
+
+Compiler::Compiler(VM &_vm) :
+	vm(_vm)
+{
+}
+
+std::shared_ptr<VmFunction>
+Compiler::compile(const std::vector<Stmt *> &statements)
+{
+	functions.emplace_back(FunctionType::NONE);
+
+	// Stack slot zero holds the function being called.
+	addLocal(std::wstring());
+	markInitialized();
+
+	for (const auto &statement : statements)
+	{
+		compile(statement);
+	}
+
+	std::shared_ptr<VmFunction> func = endFunction();
+	if (hadError)
+	{
+		return std::shared_ptr<VmFunction>();
+	}
+	return func;
+}
+
+void
+Compiler::visitAssignExpr(Assign *expr)
+{
+	compile(expr->m_value);
+	line = expr->m_name.line;
+	namedVariable(expr->m_name.text(), true);
+}
+
+void
+Compiler::visitBlockStmt(Block *stmt)
+{
+	beginScope();
+	for (const auto &statement : stmt->m_statements)
+	{
+		compile(statement);
+	}
+	endScope();
+}
+
+void
+Compiler::visitClassStmt(Class *stmt)
+{
+	line = stmt->m_name.line;
+	uint16_t nameConstant = identifierConstant(stmt->m_name.text());
+	declareVariable(stmt->m_name);
+
+	emitByte(OP_CLASS);
+	emitShort(nameConstant);
+	defineVariable(stmt->m_name);
+
+	classes.push_back(false);
+
+	if (stmt->m_superclass)
+	{
+		compile(stmt->m_superclass);
+
+		beginScope();
+		addLocal(L"super");
+		markInitialized();
+
+		namedVariable(stmt->m_name.text(), false);
+		line = stmt->m_superclass->m_name.line;
+		emitByte(OP_INHERIT);
+		classes.back() = true;
+	}
+
+	namedVariable(stmt->m_name.text(), false);
+	for (const auto &method : stmt->m_methods)
+	{
+		FunctionType type = FunctionType::METHOD;
+		if (method->m_name.lexeme == "init")
+		{
+			type = FunctionType::INITIALIZER;
+		}
+		function(method, type);
+		emitByte(OP_METHOD);
+		emitShort(identifierConstant(method->m_name.text()));
+	}
+	emitByte(OP_POP);
+
+	if (classes.back())
+	{
+		endScope();
+	}
+	classes.pop_back();
+}
+
+void
+Compiler::visitBinaryExpr(Binary *expr)
+{
+	compile(expr->m_left);
+	compile(expr->m_right);
+
+	line = expr->m_operatorX.line;
+	switch (expr->m_operatorX.type)
+	{
+		case BANG_EQUAL:
+			emitByte(OP_NOT_EQUAL);
+			break;
+		case EQUAL_EQUAL:
+			emitByte(OP_EQUAL);
+			break;
+		case GREATER:
+			emitByte(OP_GREATER);
+			break;
+		case GREATER_EQUAL:
+			emitByte(OP_GREATER_EQUAL);
+			break;
+		case LESS:
+			emitByte(OP_LESS);
+			break;
+		case LESS_EQUAL:
+			emitByte(OP_LESS_EQUAL);
+			break;
+		case PLUS:
+			emitByte(OP_ADD);
+			break;
+		case MINUS:
+			emitByte(OP_SUBTRACT);
+			break;
+		case STAR:
+			emitByte(OP_MULTIPLY);
+			break;
+		case SLASH:
+			emitByte(OP_DIVIDE);
+			break;
+		default:
+			break;
+	}
+}
+
+void
+Compiler::visitCallExpr(Call *expr)
+{
+	Get *get = dynamic_cast<Get *>(expr->m_callee);
+	Super *super = dynamic_cast<Super *>(expr->m_callee);
+
+	// Method calls are compiled to a single instruction, without
+	// creating a bound method, from 28.5.
+	if (get)
+	{
+		compile(get->m_object);
+	}
+	else if (super)
+	{
+		line = super->m_keyword.line;
+		namedVariable(L"this", false);
+	}
+	else
+	{
+		compile(expr->m_callee);
+	}
+
+	for (const auto &argument : expr->m_arguments)
+	{
+		compile(argument);
+	}
+
+	uint8_t argCount = static_cast<uint8_t>(expr->m_arguments.size());
+	line = expr->m_paren.line;
+	if (get)
+	{
+		uint16_t name = identifierConstant(get->m_name.text());
+		emitByte(OP_INVOKE);
+		emitShort(name);
+		emitByte(argCount);
+	}
+	else if (super)
+	{
+		uint16_t name = identifierConstant(super->m_method.text());
+		namedVariable(L"super", false);
+		emitByte(OP_SUPER_INVOKE);
+		emitShort(name);
+		emitByte(argCount);
+	}
+	else
+	{
+		emitBytes(OP_CALL, argCount);
+	}
+}
+
+void
+Compiler::visitGetExpr(Get *expr)
+{
+	compile(expr->m_object);
+	line = expr->m_name.line;
+	emitByte(OP_GET_PROPERTY);
+	emitShort(identifierConstant(expr->m_name.text()));
+}
+
+void
+Compiler::visitGroupingExpr(Grouping *expr)
+{
+	compile(expr->m_expression);
+}
+
+void
+Compiler::visitDoubleLiteralExpr(DoubleLiteral *expr)
+{
+	emitByte(OP_CONSTANT);
+	emitShort(makeConstant(Value(expr->m_value)));
+}
+
+void
+Compiler::visitStringLiteralExpr(StringLiteral *expr)
+{
+	emitByte(OP_CONSTANT);
+	emitShort(makeConstant(Value(expr->m_value)));
+}
+
+void
+Compiler::visitBooleanLiteralExpr(BooleanLiteral *expr)
+{
+	emitByte(expr->m_value ? OP_TRUE : OP_FALSE);
+}
+
+void
+Compiler::visitNilLiteralExpr(NilLiteral *expr)
+{
+	emitByte(OP_NIL);
+}
+
+void
+Compiler::visitLogicalExpr(Logical *expr)
+{
+	compile(expr->m_left);
+	line = expr->m_operatorX.line;
+
+	if (expr->m_operatorX.type == TokenType::OR)
+	{
+		std::size_t elseJump = emitJump(OP_JUMP_IF_FALSE);
+		std::size_t endJump = emitJump(OP_JUMP);
+		patchJump(elseJump);
+		emitByte(OP_POP);
+		compile(expr->m_right);
+		patchJump(endJump);
+	}
+	else // TokenType::AND
+	{
+		std::size_t endJump = emitJump(OP_JUMP_IF_FALSE);
+		emitByte(OP_POP);
+		compile(expr->m_right);
+		patchJump(endJump);
+	}
+}
+
+void
+Compiler::visitSetExpr(Set *expr)
+{
+	compile(expr->m_object);
+	compile(expr->m_value);
+	line = expr->m_name.line;
+	emitByte(OP_SET_PROPERTY);
+	emitShort(identifierConstant(expr->m_name.text()));
+}
+
+void
+Compiler::visitSuperExpr(Super *expr)
+{
+	line = expr->m_keyword.line;
+	uint16_t name = identifierConstant(expr->m_method.text());
+	namedVariable(L"this", false);
+	namedVariable(L"super", false);
+	emitByte(OP_GET_SUPER);
+	emitShort(name);
+}
+
+void
+Compiler::visitThisExpr(This *expr)
+{
+	line = expr->m_keyword.line;
+	namedVariable(L"this", false);
+}
+
+void
+Compiler::visitUnaryExpr(Unary *expr)
+{
+	compile(expr->m_right);
+	line = expr->m_operatorX.line;
+	if (expr->m_operatorX.type == MINUS)
+	{
+		emitByte(OP_NEGATE);
+	}
+	else if (expr->m_operatorX.type == BANG)
+	{
+		emitByte(OP_NOT);
+	}
+}
+
+void
+Compiler::visitVariableExpr(Variable *expr)
+{
+	line = expr->m_name.line;
+	namedVariable(expr->m_name.text(), false);
+}
+
+void
+Compiler::visitIfStmt(If *stmt)
+{
+	compile(stmt->m_condition);
+
+	std::size_t thenJump = emitJump(OP_JUMP_IF_FALSE);
+	emitByte(OP_POP);
+	compile(stmt->m_thenBranch);
+
+	std::size_t elseJump = emitJump(OP_JUMP);
+	patchJump(thenJump);
+	emitByte(OP_POP);
+
+	if (stmt->m_elseBranch)
+	{
+		compile(stmt->m_elseBranch);
+	}
+	patchJump(elseJump);
+}
+
+void
+Compiler::visitFunctionStmt(Function *stmt)
+{
+	line = stmt->m_name.line;
+	declareVariable(stmt->m_name);
+
+	// A local function can refer to itself, so it is defined
+	// before its body is compiled.
+	if (functions.back().scopeDepth > 0)
+	{
+		markInitialized();
+	}
+	function(stmt, FunctionType::FUNCTION);
+	defineVariable(stmt->m_name);
+}
+
+void
+Compiler::visitPrintStmt(Print *stmt)
+{
+	compile(stmt->m_expression);
+	emitByte(OP_PRINT);
+}
+
+void
+Compiler::visitReturnStmt(Return *stmt)
+{
+	line = stmt->m_keyword.line;
+	if (stmt->m_value)
+	{
+		compile(stmt->m_value);
+		emitByte(OP_RETURN);
+	}
+	else
+	{
+		emitReturn();
+	}
+}
+
+void
+Compiler::visitExpressionStmt(Expression *stmt)
+{
+	compile(stmt->m_expression);
+	emitByte(OP_POP);
+}
+
+void
+Compiler::visitVarStmt(Var *stmt)
+{
+	line = stmt->m_name.line;
+	declareVariable(stmt->m_name);
+
+	if (stmt->m_initializer)
+	{
+		compile(stmt->m_initializer);
+	}
+	else
+	{
+		emitByte(OP_NIL);
+	}
+
+	line = stmt->m_name.line;
+	defineVariable(stmt->m_name);
+}
+
+void
+Compiler::visitForStmt(For *stmt)
+{
+	beginScope();
+	if (stmt->m_initializer)
+	{
+		compile(stmt->m_initializer);
+	}
+
+	std::size_t loopStart = currentChunk().code.size();
+	std::size_t exitJump = 0;
+	if (stmt->m_condition)
+	{
+		compile(stmt->m_condition);
+		exitJump = emitJump(OP_JUMP_IF_FALSE);
+		emitByte(OP_POP);
+	}
+
+	compile(stmt->m_body);
+	if (stmt->m_increment)
+	{
+		compile(stmt->m_increment);
+		emitByte(OP_POP);
+	}
+	emitLoop(loopStart);
+
+	if (stmt->m_condition)
+	{
+		patchJump(exitJump);
+		emitByte(OP_POP);
+	}
+	endScope();
+}
+
+void
+Compiler::visitWhileStmt(While *stmt)
+{
+	std::size_t loopStart = currentChunk().code.size();
+	compile(stmt->m_condition);
+
+	std::size_t exitJump = emitJump(OP_JUMP_IF_FALSE);
+	emitByte(OP_POP);
+	compile(stmt->m_body);
+	emitLoop(loopStart);
+
+	patchJump(exitJump);
+	emitByte(OP_POP);
+}
+
+void
+Compiler::compile(Stmt *stmt)
+{
+	stmt->accept(this);
+}
+
+void
+Compiler::compile(Expr *expr)
+{
+	expr->accept(this);
+}
+
+void
+Compiler::function(Function *func, FunctionType type)
+{
+	functions.emplace_back(type);
+	functions.back().function->name = func->m_name.interned;
+	beginScope();
+
+	// Stack slot zero holds the receiver in methods and is unnamed otherwise.
+	if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER)
+	{
+		addLocal(L"this");
+	}
+	else
+	{
+		addLocal(std::wstring());
+	}
+	markInitialized();
+
+	for (const auto &param : func->m_params)
+	{
+		functions.back().function->arity++;
+		line = param.line;
+		declareVariable(param);
+		defineVariable(param);
+	}
+
+	for (const auto &statement : func->m_body)
+	{
+		compile(statement);
+	}
+
+	std::vector<CompilerUpvalue> upvalues = functions.back().upvalues;
+	std::shared_ptr<VmFunction> compiled = endFunction();
+
+	emitByte(OP_CLOSURE);
+	emitShort(makeConstant(Value(compiled)));
+	for (const auto &upvalue : upvalues)
+	{
+		emitByte(upvalue.isLocal ? 1 : 0);
+		emitByte(upvalue.index);
+	}
+}
+
+std::shared_ptr<VmFunction>
+Compiler::endFunction()
+{
+	emitReturn();
+	std::shared_ptr<VmFunction> func = functions.back().function;
+	func->upvalueCount = functions.back().upvalues.size();
+	functions.pop_back();
+	return func;
+}
+
+Chunk &
+Compiler::currentChunk()
+{
+	return functions.back().function->chunk;
+}
+
+void
+Compiler::emitByte(uint8_t byte)
+{
+	currentChunk().write(byte, line);
+}
+
+void
+Compiler::emitBytes(uint8_t byte1, uint8_t byte2)
+{
+	emitByte(byte1);
+	emitByte(byte2);
+}
+
+void
+Compiler::emitShort(uint16_t value)
+{
+	emitByte((value >> 8) & 0xff);
+	emitByte(value & 0xff);
+}
+
+std::size_t
+Compiler::emitJump(OpCode instruction)
+{
+	emitByte(instruction);
+	emitShort(0xffff);
+	return currentChunk().code.size() - 2;
+}
+
+void
+Compiler::patchJump(std::size_t offset)
+{
+	// -2 to adjust for the bytecode for the jump offset itself.
+	std::size_t jump = currentChunk().code.size() - offset - 2;
+	if (jump > std::numeric_limits<uint16_t>::max())
+	{
+		error(L"Too much code to jump over.");
+	}
+	currentChunk().code.at(offset) = (jump >> 8) & 0xff;
+	currentChunk().code.at(offset + 1) = jump & 0xff;
+}
+
+void
+Compiler::emitLoop(std::size_t loopStart)
+{
+	emitByte(OP_LOOP);
+
+	std::size_t offset = currentChunk().code.size() - loopStart + 2;
+	if (offset > std::numeric_limits<uint16_t>::max())
+	{
+		error(L"Loop body too large.");
+	}
+	emitShort(static_cast<uint16_t>(offset));
+}
+
+void
+Compiler::emitReturn()
+{
+	if (functions.back().type == FunctionType::INITIALIZER)
+	{
+		emitBytes(OP_GET_LOCAL, 0);
+	}
+	else
+	{
+		emitByte(OP_NIL);
+	}
+	emitByte(OP_RETURN);
+}
+
+uint16_t
+Compiler::makeConstant(const Value &value)
+{
+	std::size_t constant = currentChunk().addConstant(value);
+	if (constant > std::numeric_limits<uint16_t>::max())
+	{
+		error(L"Too many constants in one chunk.");
+		return 0;
+	}
+	return static_cast<uint16_t>(constant);
+}
+
+uint16_t
+Compiler::identifierConstant(const std::wstring &name)
+{
+	return makeConstant(Value(vm.identifier(name)));
+}
+
+void
+Compiler::beginScope()
+{
+	functions.back().scopeDepth++;
+}
+
+void
+Compiler::endScope()
+{
+	FunctionCompiler &current = functions.back();
+	current.scopeDepth--;
+
+	while (!current.locals.empty() &&
+		current.locals.back().depth > current.scopeDepth)
+	{
+		if (current.locals.back().isCaptured)
+		{
+			emitByte(OP_CLOSE_UPVALUE);
+		}
+		else
+		{
+			emitByte(OP_POP);
+		}
+		current.locals.pop_back();
+	}
+}
+
+void
+Compiler::addLocal(const std::wstring &name)
+{
+	if (functions.back().locals.size() > std::numeric_limits<uint8_t>::max())
+	{
+		error(L"Too many local variables in function.");
+		return;
+	}
+
+	CompilerLocal local;
+	local.name = name;
+	functions.back().locals.push_back(local);
+}
+
+void
+Compiler::markInitialized()
+{
+	FunctionCompiler &current = functions.back();
+	if (current.scopeDepth == 0 || current.locals.empty())
+	{
+		return;
+	}
+	current.locals.back().depth = current.scopeDepth;
+}
+
+void
+Compiler::declareVariable(const Token &name)
+{
+	// Global variables are late bound and not declared.
+	if (functions.back().scopeDepth == 0)
+	{
+		return;
+	}
+	addLocal(name.text());
+}
+
+void
+Compiler::defineVariable(const Token &name)
+{
+	if (functions.back().scopeDepth > 0)
+	{
+		markInitialized();
+		return;
+	}
+
+	std::size_t global = vm.globalIndex(name.text());
+	if (global > std::numeric_limits<uint16_t>::max())
+	{
+		error(L"Too many global variables.");
+		return;
+	}
+	emitByte(OP_DEFINE_GLOBAL);
+	emitShort(static_cast<uint16_t>(global));
+}
+
+int
+Compiler::resolveLocal(std::size_t level, const std::wstring &name)
+{
+	const std::vector<CompilerLocal> &locals = functions.at(level).locals;
+	for (int i = locals.size() - 1; i >= 0; i--)
+	{
+		if (locals.at(i).name == name)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int
+Compiler::resolveUpvalue(std::size_t level, const std::wstring &name)
+{
+	if (level == 0)
+	{
+		return -1;
+	}
+
+	int local = resolveLocal(level - 1, name);
+	if (local != -1)
+	{
+		functions.at(level - 1).locals.at(local).isCaptured = true;
+		return addUpvalue(level, static_cast<uint8_t>(local), true);
+	}
+
+	int upvalue = resolveUpvalue(level - 1, name);
+	if (upvalue != -1)
+	{
+		return addUpvalue(level, static_cast<uint8_t>(upvalue), false);
+	}
+	return -1;
+}
+
+int
+Compiler::addUpvalue(std::size_t level, uint8_t index, bool isLocal)
+{
+	std::vector<CompilerUpvalue> &upvalues = functions.at(level).upvalues;
+	for (std::size_t i = 0; i < upvalues.size(); i++)
+	{
+		if (upvalues.at(i).index == index && upvalues.at(i).isLocal == isLocal)
+		{
+			return i;
+		}
+	}
+
+	if (upvalues.size() > std::numeric_limits<uint8_t>::max())
+	{
+		error(L"Too many closure variables in function.");
+		return 0;
+	}
+
+	CompilerUpvalue upvalue;
+	upvalue.index = index;
+	upvalue.isLocal = isLocal;
+	upvalues.push_back(upvalue);
+	return upvalues.size() - 1;
+}
+
+void
+Compiler::namedVariable(const std::wstring &name, bool assign)
+{
+	std::size_t level = functions.size() - 1;
+	int arg = resolveLocal(level, name);
+	if (arg != -1)
+	{
+		emitBytes(assign ? OP_SET_LOCAL : OP_GET_LOCAL, static_cast<uint8_t>(arg));
+		return;
+	}
+
+	arg = resolveUpvalue(level, name);
+	if (arg != -1)
+	{
+		emitBytes(assign ? OP_SET_UPVALUE : OP_GET_UPVALUE, static_cast<uint8_t>(arg));
+		return;
+	}
+
+	std::size_t global = vm.globalIndex(name);
+	if (global > std::numeric_limits<uint16_t>::max())
+	{
+		error(L"Too many global variables.");
+		return;
+	}
+	emitByte(assign ? OP_SET_GLOBAL : OP_GET_GLOBAL);
+	emitShort(static_cast<uint16_t>(global));
+}
+
+void
+Compiler::error(const std::wstring &message)
+{
+	Lox::error(line, message);
+	hadError = true;
+}
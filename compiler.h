@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "expr.h"
+#include "stmt.h"
+#include "resolver.h"
+#include "vmobjects.h"
+
+class VM;
+
+/*
+ * A local variable in a function being compiled, from 22.2.
+ */
+class CompilerLocal
+{
+public:
+	std::wstring name;
+
+	/*
+	 * Scope depth, or -1 while the variable is declared but not yet defined.
+	 */
+	int depth = -1;
+
+	bool isCaptured = false;
+};
+
+/*
+ * A variable captured by a function being compiled, from 25.2.
+ */
+class CompilerUpvalue
+{
+public:
+	uint8_t index = 0;
+
+	bool isLocal = false;
+};
+
+/*
+ * Compilation state of one function. Functions nested inside it are
+ * compiled with their own FunctionCompiler.
+ */
+class FunctionCompiler
+{
+public:
+	FunctionCompiler(FunctionType _type);
+
+	std::shared_ptr<VmFunction> function;
+
+	FunctionType type;
+
+	std::vector<CompilerLocal> locals;
+
+	std::vector<CompilerUpvalue> upvalues;
+
+	int scopeDepth = 0;
+};
+
+/**
+ * Compiles a resolved syntax tree to bytecode for the VM.
+ * Replaces the single-pass compiler of Chapters 17-28 of the book, so that
+ * the Scanner, Parser and Resolver are shared with the Interpreter.
+ */
+class Compiler : public ExprVisitor<void>, public StmtVisitor<void>
+{
+public:
+	Compiler(VM &_vm);
+
+	/*
+	 * Compile the top-level statements to a function, or return null
+	 * if there was a compile error.
+	 */
+	std::shared_ptr<VmFunction> compile(const std::vector<Stmt *> &statements);
+
+	void visitAssignExpr(Assign *expr);
+
+	void visitBlockStmt(Block *stmt);
+
+	void visitClassStmt(Class *stmt);
+
+	void visitBinaryExpr(Binary *expr);
+
+	void visitCallExpr(Call *expr);
+
+	void visitGetExpr(Get *expr);
+
+	void visitGroupingExpr(Grouping *expr);
+
+	void visitDoubleLiteralExpr(DoubleLiteral *expr);
+
+	void visitStringLiteralExpr(StringLiteral *expr);
+
+	void visitBooleanLiteralExpr(BooleanLiteral *expr);
+
+	void visitNilLiteralExpr(NilLiteral *expr);
+
+	void visitLogicalExpr(Logical *expr);
+
+	void visitSetExpr(Set *expr);
+
+	void visitSuperExpr(Super *expr);
+
+	void visitThisExpr(This *expr);
+
+	void visitUnaryExpr(Unary *expr);
+
+	void visitVariableExpr(Variable *expr);
+
+	void visitIfStmt(If *stmt);
+
+	void visitForStmt(For *stmt);
+
+	void visitFunctionStmt(Function *stmt);
+
+	void visitPrintStmt(Print *stmt);
+
+	void visitReturnStmt(Return *stmt);
+
+	void visitExpressionStmt(Expression *stmt);
+
+	void visitVarStmt(Var *stmt);
+
+	void visitWhileStmt(While *stmt);
+
+private:
+	VM &vm;
+
+	/*
+	 * Functions being compiled, innermost last.
+	 */
+	std::vector<FunctionCompiler> functions;
+
+	/*
+	 * Classes being compiled, innermost last, true if the class has a superclass.
+	 */
+	std::vector<bool> classes;
+
+	/*
+	 * Source line of the node being compiled.
+	 */
+	int line = 0;
+
+	bool hadError = false;
+
+	void compile(Stmt *stmt);
+
+	void compile(Expr *expr);
+
+	void function(Function *func, FunctionType type);
+
+	std::shared_ptr<VmFunction> endFunction();
+
+	Chunk &currentChunk();
+
+	void emitByte(uint8_t byte);
+
+	void emitBytes(uint8_t byte1, uint8_t byte2);
+
+	void emitShort(uint16_t value);
+
+	std::size_t emitJump(OpCode instruction);
+
+	void patchJump(std::size_t offset);
+
+	void emitLoop(std::size_t loopStart);
+
+	void emitReturn();
+
+	uint16_t makeConstant(const Value &value);
+
+	uint16_t identifierConstant(const std::wstring &name);
+
+	void beginScope();
+
+	void endScope();
+
+	void addLocal(const std::wstring &name);
+
+	void markInitialized();
+
+	void declareVariable(const Token &name);
+
+	void defineVariable(const Token &name);
+
+	int resolveLocal(std::size_t level, const std::wstring &name);
+
+	int resolveUpvalue(std::size_t level, const std::wstring &name);
+
+	int addUpvalue(std::size_t level, uint8_t index, bool isLocal);
+
+	void namedVariable(const std::wstring &name, bool assign);
+
+	void error(const std::wstring &message);
+};
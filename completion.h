@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * How execution of a statement completed, replacing the ReturnError
+ * exception from 10.5.1. After a RETURN, the returned value is held by
+ * the Interpreter until the enclosing function call collects it.
+ */
+enum class Completion
+{
+	NORMAL,
+	RETURN
+};
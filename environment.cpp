@@ -1,25 +1,43 @@
 #include "environment.h"
 #include "runtimeerror.h"
+#include "executionstats.h"
 
 Environment::Environment()
 {
+	ExecutionStats::count(ExecutionStats::ENVIRONMENTS);
 }
 
 Environment::Environment(std::shared_ptr<Environment> enclosingEnvironment)
 {
+	ExecutionStats::count(ExecutionStats::ENVIRONMENTS);
 	enclosing = enclosingEnvironment;
 }
 
+Environment::Environment(std::shared_ptr<Environment> enclosingEnvironment,
+	std::size_t localCount)
+{
+	ExecutionStats::count(ExecutionStats::ENVIRONMENTS);
+	enclosing = enclosingEnvironment;
+	slots.reserve(localCount);
+}
+
 void
-Environment::define(const std::wstring &name, std::shared_ptr<Expr> value)
+Environment::define(const std::shared_ptr<LoxString> &name, const Value &value)
 {
 	values.insert_or_assign(name, value);
 }
 
-std::shared_ptr<Expr>
-Environment::get(std::shared_ptr<Token> name)
+std::size_t
+Environment::define(const Value &value)
+{
+	slots.push_back(value);
+	return slots.size() - 1;
+}
+
+Value
+Environment::get(const Token &name)
 {
-	auto it = values.find(name->lexeme);
+	auto it = values.find(name.interned);
 
 	if (it != values.end())
 	{
@@ -31,39 +49,33 @@ Environment::get(std::shared_ptr<Token> name)
 		return enclosing->get(name);
 	}
 
-	throw RuntimeError(name, L"Undefined variable '" + name->lexeme + L"'.");
+	throw RuntimeError(name, L"Undefined variable '" + name.text() + L"'.");
 }
 
-std::shared_ptr<Expr>
-Environment::getAt(int distance, const std::wstring &name)
+const Value &
+Environment::getAt(int distance, int slot)
 {
-	std::shared_ptr<Environment> env = ancestor(distance);
-	return env->values.find(name)->second;
+	return ancestor(distance)->slots[slot];
 }
 
-std::shared_ptr<Environment>
+Environment *
 Environment::ancestor(int distance)
 {
-	if (distance == 0)
-	{
-		return shared_from_this();
-	}
-
-	std::shared_ptr<Environment> env = this->enclosing;
-	for (int i = 1; i < distance; i++)
+	Environment *env = this;
+	for (int i = 0; i < distance; i++)
 	{
-		env = env->enclosing;
+		env = env->enclosing.get();
 	}
 	return env;
 }
 
 void
-Environment::assign(std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
+Environment::assign(const Token &name, const Value &value)
 {
-	auto it = values.find(name->lexeme);
+	auto it = values.find(name.interned);
 	if (it != values.end())
 	{
-		values.insert_or_assign(name->lexeme, value);
+		it->second = value;
 		return;
 	}
 
@@ -73,13 +85,13 @@ Environment::assign(std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
 		return;
 	}
 
-	throw RuntimeError(name, L"Undefined variable '" + name->lexeme + L"'.");
+	throw RuntimeError(name, L"Undefined variable '" + name.text() + L"'.");
 }
 
 void
-Environment::assignAt(int distance, std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
+Environment::assignAt(int distance, int slot, const Value &value)
 {
-	ancestor(distance)->values.insert_or_assign(name->lexeme, value);
+	ancestor(distance)->slots[slot] = value;
 }
 
 std::shared_ptr<Environment>
@@ -87,3 +99,28 @@ Environment::getEnclosing()
 {
 	return enclosing;
 }
+
+void
+Environment::traceReferences(std::vector<HeapObject *> &references)
+{
+	for (const auto &entry : values)
+	{
+		entry.second.traceReference(references);
+	}
+	for (const auto &slot : slots)
+	{
+		slot.traceReference(references);
+	}
+	if (enclosing)
+	{
+		references.push_back(enclosing.get());
+	}
+}
+
+void
+Environment::clearReferences()
+{
+	values.clear();
+	slots.clear();
+	enclosing.reset();
+}
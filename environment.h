@@ -1,34 +1,60 @@
 #pragma once
 
-#include <any>
-#include <map>
+#include <unordered_map>
 #include <string>
+#include <vector>
 #include <memory>
 
-#include "expr.h"
-
-class Environment : public std::enable_shared_from_this<Environment>
+#include "token.h"
+#include "value.h"
+#include "loxstring.h"
+#include "heap.h"
+
+/**
+ * Variables of a scope, from Chapter 8.3.
+ *
+ * The global environment holds variables by their interned name, as they
+ * are late bound.
+ * Local variables are held in slots, numbered by the Resolver in order of
+ * declaration, so they are accessed by index.
+ */
+class Environment : public HeapObject
 {
 public:
 	Environment();
 
 	Environment(std::shared_ptr<Environment> enclosingEnvironment);
 
-	void define(const std::wstring &name, std::shared_ptr<Expr> value);
+	/*
+	 * An environment with room for a number of local variables.
+	 */
+	Environment(std::shared_ptr<Environment> enclosingEnvironment, std::size_t localCount);
+
+	void define(const std::shared_ptr<LoxString> &name, const Value &value);
+
+	/*
+	 * Define the next local variable, returning its slot.
+	 */
+	std::size_t define(const Value &value);
 
-	std::shared_ptr<Expr> get(std::shared_ptr<Token> name);
+	Value get(const Token &name);
 
-	std::shared_ptr<Expr> getAt(int distance, const std::wstring &name);
+	const Value &getAt(int distance, int slot);
 
-	void assign(std::shared_ptr<Token> name, std::shared_ptr<Expr> value);
+	void assign(const Token &name, const Value &value);
 
-	void assignAt(int distance, std::shared_ptr<Token> name, std::shared_ptr<Expr> value);
+	void assignAt(int distance, int slot, const Value &value);
 
 	std::shared_ptr<Environment> getEnclosing();
 
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+
 private:
-	std::map<std::wstring, std::shared_ptr<Expr>> values;
+	std::unordered_map<std::shared_ptr<LoxString>, Value> values;
+	std::vector<Value> slots;
 	std::shared_ptr<Environment> enclosing;
 
-	std::shared_ptr<Environment> ancestor(int distance);
+	Environment *ancestor(int distance);
 };
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+#include <cxxabi.h>
+
+#include "executionstats.h"
+
+bool ExecutionStats::enabled = false;
+std::array<std::size_t, ExecutionStats::COUNTERS> ExecutionStats::counters = {};
+std::unordered_map<const Expr *, std::size_t> ExecutionStats::exprs;
+std::unordered_map<const Stmt *, std::size_t> ExecutionStats::stmts;
+
+static std::string
+typeName(const std::type_info &type)
+{
+	int status = 0;
+	char *name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+	if (status != 0)
+	{
+		return type.name();
+	}
+	std::string result(name);
+	free(name);
+	return result;
+}
+
+/*
+ * The line of an expression, or 0 if it has no token.
+ */
+static int
+lineOf(const Expr *expr)
+{
+	if (auto e = dynamic_cast<const Assign *>(expr))
+		return e->m_name.line;
+	if (auto e = dynamic_cast<const Binary *>(expr))
+		return e->m_operatorX.line;
+	if (auto e = dynamic_cast<const Call *>(expr))
+		return e->m_paren.line;
+	if (auto e = dynamic_cast<const Get *>(expr))
+		return e->m_name.line;
+	if (auto e = dynamic_cast<const Grouping *>(expr))
+		return lineOf(e->m_expression);
+	if (auto e = dynamic_cast<const Logical *>(expr))
+		return e->m_operatorX.line;
+	if (auto e = dynamic_cast<const Set *>(expr))
+		return e->m_name.line;
+	if (auto e = dynamic_cast<const Super *>(expr))
+		return e->m_keyword.line;
+	if (auto e = dynamic_cast<const This *>(expr))
+		return e->m_keyword.line;
+	if (auto e = dynamic_cast<const Unary *>(expr))
+		return e->m_operatorX.line;
+	if (auto e = dynamic_cast<const Variable *>(expr))
+		return e->m_name.line;
+	return 0;
+}
+
+/*
+ * The line of a statement, or 0 for a block, which spans several.
+ */
+static int
+lineOf(const Stmt *stmt)
+{
+	if (auto s = dynamic_cast<const Class *>(stmt))
+		return s->m_name.line;
+	if (auto s = dynamic_cast<const Expression *>(stmt))
+		return lineOf(s->m_expression);
+	if (auto s = dynamic_cast<const For *>(stmt))
+		return s->m_condition ? lineOf(s->m_condition) : 0;
+	if (auto s = dynamic_cast<const Function *>(stmt))
+		return s->m_name.line;
+	if (auto s = dynamic_cast<const If *>(stmt))
+		return lineOf(s->m_condition);
+	if (auto s = dynamic_cast<const Print *>(stmt))
+		return lineOf(s->m_expression);
+	if (auto s = dynamic_cast<const Return *>(stmt))
+		return s->m_keyword.line;
+	if (auto s = dynamic_cast<const Var *>(stmt))
+		return s->m_name.line;
+	if (auto s = dynamic_cast<const While *>(stmt))
+		return lineOf(s->m_condition);
+	return 0;
+}
+
+void
+ExecutionStats::enable()
+{
+	enabled = true;
+}
+
+void
+ExecutionStats::print()
+{
+	std::map<std::string, std::size_t> kinds;
+	std::size_t nodes = 0;
+	for (const auto &e : exprs)
+	{
+		kinds[typeName(typeid(*e.first))] += e.second;
+		nodes += e.second;
+	}
+	std::map<int, std::size_t> lines;
+	for (const auto &s : stmts)
+	{
+		kinds[typeName(typeid(*s.first))] += s.second;
+		nodes += s.second;
+		int line = lineOf(s.first);
+		if (line > 0)
+		{
+			lines[line] += s.second;
+		}
+	}
+
+	std::wcerr << "Nodes executed: " << nodes << std::endl;
+	std::vector<std::pair<std::string, std::size_t>> byKind(kinds.begin(), kinds.end());
+	std::stable_sort(byKind.begin(), byKind.end(),
+		[](const auto &a, const auto &b)
+		{
+			return a.second > b.second;
+		});
+	for (const auto &kind : byKind)
+	{
+		std::wcerr << "  " << std::left << std::setw(16) << kind.first.c_str() <<
+			std::right << std::setw(12) << kind.second << std::endl;
+	}
+
+	// Lines executed most often, at most 10.
+	std::vector<std::pair<int, std::size_t>> byLine(lines.begin(), lines.end());
+	std::stable_sort(byLine.begin(), byLine.end(),
+		[](const auto &a, const auto &b)
+		{
+			return a.second > b.second;
+		});
+	byLine.resize(std::min<std::size_t>(byLine.size(), 10));
+	std::wcerr << "Statements executed by line:" << std::endl;
+	for (const auto &line : byLine)
+	{
+		std::wcerr << "  line " << std::left << std::setw(10) << line.first <<
+			std::right << std::setw(12) << line.second << std::endl;
+	}
+
+	std::wcerr << "Environments allocated: " << counters[ENVIRONMENTS] << std::endl;
+	std::wcerr << "Stack frames: " << counters[STACK_FRAMES] << std::endl;
+	std::wcerr << "Bound methods created: " << counters[BOUND_METHODS] << std::endl;
+	std::wcerr << "Instances created: " << counters[INSTANCES] << std::endl;
+	std::wcerr << "String concatenations: " << counters[CONCATENATIONS] << std::endl;
+}
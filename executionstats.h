@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+
+#include "expr.h"
+#include "stmt.h"
+
+/**
+ * Counters of the work done by the tree-walking interpreter, for the
+ * --stats option, to show whether a script spends its time dispatching
+ * on syntax tree nodes or allocating objects.
+ *
+ * Each node executed is counted by its address, and the counts are
+ * summed by node type and by source line when they are printed, so that
+ * counting costs one hash table update per node.
+ */
+class ExecutionStats
+{
+public:
+	enum Counter
+	{
+		ENVIRONMENTS,
+		STACK_FRAMES,
+		BOUND_METHODS,
+		INSTANCES,
+		CONCATENATIONS,
+		COUNTERS
+	};
+
+	static bool isEnabled()
+	{
+		return enabled;
+	}
+
+	static void enable();
+
+	static void count(Counter counter)
+	{
+		if (enabled)
+		{
+			counters[counter]++;
+		}
+	}
+
+	static void countNode(const Expr *expr)
+	{
+		exprs[expr]++;
+	}
+
+	static void countNode(const Stmt *stmt)
+	{
+		stmts[stmt]++;
+	}
+
+	/*
+	 * Print the counts to standard error.
+	 */
+	static void print();
+
+private:
+	static bool enabled;
+
+	static std::array<std::size_t, COUNTERS> counters;
+
+	static std::unordered_map<const Expr *, std::size_t> exprs;
+
+	static std::unordered_map<const Stmt *, std::size_t> stmts;
+};
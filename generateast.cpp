@@ -32,25 +32,15 @@ to_lower(const std::wstring &str)
 	return lower;
 }
 
-void
-defineType(std::wofstream &f,
-	const std::wstring &baseName,
-	const std::wstring &className,
-	const std::wstring &fieldList)
+/*
+ * Split a comma separated list of fields into a vector of fields.
+ */
+std::vector<std::wstring>
+splitFields(const std::wstring &fieldList)
 {
-	f << std::endl;
-	f << "class " << className << " : public " <<
-		baseName << ", public std::enable_shared_from_this<" <<
-		className << ">" << std::endl;
-	f << "{" << std::endl;
-	f << "public:" << std::endl;
-
-
-	// Store parameters in fields.
 	std::wstring::size_type beginIndex = 0;
 	std::wstring::size_type endIndex = 0;
 	std::vector<std::wstring> fields;
-	std::wstring separator;
 	do
 	{
 		std::wstring field;
@@ -74,6 +64,62 @@ defineType(std::wofstream &f,
 	}
 	while (endIndex != std::wstring::npos);
 
+	return fields;
+}
+
+/*
+ * Index of the name in the declaration of a field, ignoring any initial
+ * value. The name follows the last space or '*' of the type.
+ */
+std::wstring::size_type
+nameIndex(const std::wstring &field)
+{
+	std::wstring declaration = trim(field.substr(0, field.find(L'=')));
+	return declaration.find_last_of(L" *") + 1;
+}
+
+/*
+ * Write the declaration of a field, adding the "m_" prefix to its name.
+ */
+void
+defineField(std::wofstream &f, std::wstring field)
+{
+	field.insert(nameIndex(field), L"m_");
+	f << L"\t" << field << L";" << std::endl;
+}
+
+/*
+ * Generate a syntax tree class. The fields before an optional '|' in
+ * fieldList are constructor parameters, the fields after it are set
+ * later, by the Resolver or the Interpreter, and are declared with their
+ * initial values.
+ */
+void
+defineType(std::wofstream &f,
+	const std::wstring &baseName,
+	const std::wstring &className,
+	std::wstring fieldList,
+	const std::vector<std::wstring> &returnTypes)
+{
+	std::vector<std::wstring> extraFields;
+	std::wstring::size_type barIndex = fieldList.find(L'|');
+	if (barIndex != std::wstring::npos)
+	{
+		extraFields = splitFields(fieldList.substr(barIndex + 1));
+		fieldList = fieldList.substr(0, barIndex);
+	}
+	fieldList = trim(fieldList);
+
+	f << std::endl;
+	f << "class " << className << " : public " << baseName << std::endl;
+	f << "{" << std::endl;
+	f << "public:" << std::endl;
+
+
+	// Store parameters in fields.
+	std::vector<std::wstring> fields = splitFields(fieldList);
+	std::wstring separator;
+
 	// Constructor.
 	f << "\t" << className << "(" << fieldList << ")";
 	if (!fields.empty())
@@ -84,45 +130,34 @@ defineType(std::wofstream &f,
 
 	for (std::wstring field : fields)
 	{
-		std::wstring::size_type index = field.find(L'*');
-		if (index == std::wstring::npos)
-		{
-			index = field.find(L' ');
-		}
-		if (index != std::wstring::npos)
-		{
-			field = field.substr(index + 1);
-		}
-
-		std::wstring name;
-		f << L"\t\t" << separator << "m_" << field << "(" << field << ")" << std::endl;
+		field = field.substr(nameIndex(field));
+		f << L"\t\t" << separator << "m_" << field << "(std::move(" << field << "))" << std::endl;
 		separator = L",";
 	}
 
 	f << L"\t{" << std::endl;
 	f << L"\t}" << std::endl;
 
-	// Visitor pattern.
-	f << L"\tstd::any accept(" << baseName << "Visitor *visitor)" << std::endl;
-	f << L"\t{" << std::endl;
-	f << L"\t\treturn visitor->visit" << className << baseName <<
-		"(shared_from_this());" << std::endl;
-	f << L"\t}" << std::endl;
+	// Visitor pattern, one accept() method for each return type.
+	for (const auto &returnType : returnTypes)
+	{
+		f << L"\t" << returnType << " accept(" << baseName << "Visitor<" <<
+			returnType << "> *visitor)" << std::endl;
+		f << L"\t{" << std::endl;
+		f << L"\t\treturn visitor->visit" << className << baseName <<
+			"(this);" << std::endl;
+		f << L"\t}" << std::endl;
+	}
 
 	// Fields.
 	f << std::endl;
-	for (std::wstring field : fields)
+	for (const auto &field : fields)
 	{
-		std::wstring::size_type index = field.find(L'*');
-		if (index == std::wstring::npos)
-		{
-			index = field.find(L' ');
-		}
-		if (index != std::wstring::npos)
-		{
-			field.insert(index + 1, L"m_");
-		}
-		f << L"\t" << field << L";" << std::endl;
+		defineField(f, field);
+	}
+	for (const auto &field : extraFields)
+	{
+		defineField(f, field);
 	}
 
 	f << L"};" << std::endl;
@@ -167,24 +202,31 @@ defineVisitor(
 	}
 
 	f << std::endl;
+	f << L"template <class R>" << std::endl;
 	f << L"class " << baseName << "Visitor" << std::endl;
 	f << L"{" << std::endl;
 	f << L"public:" << std::endl;
 
 	for (const auto &typeName : typeNames)
 	{
-		f << L"\tvirtual std::any visit" << typeName << baseName <<
-			"(std::shared_ptr<" << typeName << "> " << lower << ") = 0;" <<
+		f << L"\tvirtual R visit" << typeName << baseName <<
+			"(" << typeName << " *" << lower << ") = 0;" <<
 		       	std::endl;
 	}
 
 	f << L"};" << std::endl;
 }
 
+/*
+ * Generate the syntax tree classes for baseName. Visitors are templates
+ * on their return type, and returnTypes lists the return types of the
+ * visitors that are used.
+ */
 void
 defineAst(char *outputDir,
 	const std::wstring &baseName,
-	const std::vector<std::wstring> &types)
+	const std::vector<std::wstring> &types,
+	const std::vector<std::wstring> &returnTypes)
 {
 	std::string dir(outputDir);
 	std::filesystem::path outPath(dir);
@@ -196,8 +238,13 @@ defineAst(char *outputDir,
 	f << std::endl;
 	f << L"#include <memory>" << std::endl;
 	f << L"#include <vector>" << std::endl;
-	f << L"#include <any>" << std::endl;
+	f << L"#include <string>" << std::endl;
+	f << L"#include <utility>" << std::endl;
 	f << L"#include \"token.h\"" << std::endl;
+	f << L"#include \"loxstring.h\"" << std::endl;
+	f << L"#include \"value.h\"" << std::endl;
+	f << L"#include \"completion.h\"" << std::endl;
+	f << L"#include \"propertycache.h\"" << std::endl;
 	f << std::endl;
 
 	defineExprClasses(f, types);
@@ -210,8 +257,12 @@ defineAst(char *outputDir,
 	f << L"public:" << std::endl;
 
 
-	// The base accept() method.
-	f << L"\tvirtual std::any accept(" << baseName << "Visitor *visitor) = 0;" << std::endl;
+	// The base accept() methods.
+	for (const auto &returnType : returnTypes)
+	{
+		f << L"\tvirtual " << returnType << " accept(" << baseName <<
+			"Visitor<" << returnType << "> *visitor) = 0;" << std::endl;
+	}
 	f << L"};" << std::endl;
 
 	for (const auto &entry : types)
@@ -222,7 +273,7 @@ defineAst(char *outputDir,
 			auto className = entry.substr(0, index);
 			className = trim(className);
 			auto fields = entry.substr(index + 1);
-			defineType(f, baseName, className, fields);
+			defineType(f, baseName, className, fields, returnTypes);
 		}
 	}
 }
@@ -239,35 +290,80 @@ main(int argc, char *argv[])
 
 	const std::vector<std::wstring> types =
 	{
-		L"Assign   : std::shared_ptr<Token> name, std::shared_ptr<Expr> value",
-		L"Binary   : std::shared_ptr<Expr> left, std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> right",
-		L"Call     : std::shared_ptr<Expr> callee, std::shared_ptr<Token> paren, std::vector<std::shared_ptr<Expr>> arguments",
-		L"Get      : std::shared_ptr<Expr> object, std::shared_ptr<Token> name",
-		L"Grouping : std::shared_ptr<Expr> expression",
+		L"Assign   : Token name, Expr *value | int depth = -1, int slot = 0",
+		L"Binary   : Expr *left, Token operatorX, Expr *right",
+		L"Call     : Expr *callee, Token paren, std::vector<Expr *> arguments | Get *invoke = nullptr",
+		L"Get      : Expr *object, Token name | PropertyCache cache",
+		L"Grouping : Expr *expression",
 		L"DoubleLiteral  : double value",
-		L"StringLiteral  : std::wstring value",
+		L"StringLiteral  : std::shared_ptr<LoxString> value",
 		L"BooleanLiteral  : bool value",
 		L"NilLiteral  :",
-		L"Logical  : std::shared_ptr<Expr> left, std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> right",
-		L"Set      : std::shared_ptr<Expr> object, std::shared_ptr<Token> name, std::shared_ptr<Expr> value",
-		L"Super    : std::shared_ptr<Token> keyword, std::shared_ptr<Token> method",
-		L"This     : std::shared_ptr<Token> keyword",
-		L"Unary    : std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> right",
-		L"Variable : std::shared_ptr<Token> name"
+		L"Logical  : Expr *left, Token operatorX, Expr *right",
+		L"Set      : Expr *object, Token name, Expr *value | PropertyCache cache",
+		L"Super    : Token keyword, Token method | int depth = -1",
+		L"This     : Token keyword | int depth = -1, int slot = 0",
+		L"Unary    : Token operatorX, Expr *right",
+		L"Variable : Token name | int depth = -1, int slot = 0"
+	};
+	// Assign, Super, This and Variable also store the number of scopes
+	// between their use and the declaration of the variable, and its slot
+	// in that scope, as computed by the Resolver. A depth of -1 means the
+	// variable is global, and a depth of STACK_DEPTH means it is in that
+	// slot of the current frame on the interpreter's value stack. Get and Set have an inline cache of the
+	// property lookup. Call stores its callee again in invoke if it is a
+	// Get, so that methods can be called without binding them first.
+	//
+	// Nodes are allocated in an Arena and refer to each other by pointer,
+	// tokens are held by value.
+
+	// Resolver and Compiler return nothing, Interpreter returns the
+	// value of the expression, AstPrinter returns a string and Optimizer
+	// returns the expression that replaces it.
+	const std::vector<std::wstring> returnTypes =
+	{
+		L"void",
+		L"Value",
+		L"std::wstring",
+		L"Expr *"
 	};
-	defineAst(outputDir, L"Expr", types);
+	defineAst(outputDir, L"Expr", types, returnTypes);
 
 	const std::vector<std::wstring> statementTypes =
 	{
-		L"Block      : std::vector<std::shared_ptr<Stmt>> statements",
-		L"Class      : std::shared_ptr<Token> name, std::shared_ptr<Variable> superclass, std::vector<std::shared_ptr<Function>> methods",
-		L"Expression : std::shared_ptr<Expr> expression",
-		L"Function   : std::shared_ptr<Token> name, std::vector<std::shared_ptr<Token>> params, std::vector<std::shared_ptr<Stmt>> body",
-		L"If         : std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch",
-		L"Print      : std::shared_ptr<Expr> expression",
-		L"Return     : std::shared_ptr<Token> keyword, std::shared_ptr<Expr> value",
-		L"Var        : std::shared_ptr<Token> name, std::shared_ptr<Expr> initializer",
-		L"While      : std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body"
+		L"Block      : std::vector<Stmt *> statements | int locals = -1",
+		L"Class      : Token name, Variable *superclass, std::vector<Function *> methods",
+		L"Expression : Expr *expression",
+		L"For        : Stmt *initializer, Expr *condition, Expr *increment, Stmt *body | int locals = -1",
+		L"Function   : Token name, std::vector<Token> params, std::vector<Stmt *> body | int frameSize = -1",
+		L"If         : Expr *condition, Stmt *thenBranch, Stmt *elseBranch",
+		L"Print      : Expr *expression",
+		L"Return     : Token keyword, Expr *value",
+		L"Var        : Token name, Expr *initializer | int slot = -1",
+		L"While      : Expr *condition, Stmt *body"
+	};
+	// For keeps its clauses rather than being rewritten as a while loop
+	// in blocks, so that the loop variable needs only one environment.
+	// Its initializer, condition and increment may be nullptr. Block and
+	// For store the number of variables in the environment they create,
+	// as counted by the Resolver, or -1 if they were not resolved. If it
+	// is 0 they create no environment, as they declare nothing or their
+	// variables are on the value stack.
+	//
+	// Function stores the number of slots of its frame on the value
+	// stack, or -1 if its locals are in environments because a closure
+	// may capture them. Var stores the slot of its variable in that
+	// frame, or -1.
+
+	// Interpreter returns how the statement completed, AstPrinter
+	// returns a string and Optimizer returns the statement that replaces
+	// it, or nullptr to remove it.
+	const std::vector<std::wstring> statementReturnTypes =
+	{
+		L"void",
+		L"Completion",
+		L"std::wstring",
+		L"Stmt *"
 	};
-	defineAst(outputDir, L"Stmt", statementTypes);
+	defineAst(outputDir, L"Stmt", statementTypes, statementReturnTypes);
 }
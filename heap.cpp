@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <iostream>
+
+#include "heap.h"
+
+HeapObject::~HeapObject()
+{
+	if (heapSize > 0)
+	{
+		Heap::objectFreed(this);
+	}
+}
+
+void
+HeapObject::traceReferences(std::vector<HeapObject *> &references)
+{
+}
+
+void
+HeapObject::clearReferences()
+{
+}
+
+std::array<Heap::Generation, Heap::GENERATIONS> &
+Heap::generations()
+{
+	// Like CPython, collect generation 0 after 700 allocations, and the
+	// older generations after 10 collections of the next younger one.
+	static std::array<Generation, GENERATIONS> gens = []()
+	{
+		std::array<Generation, GENERATIONS> g;
+		g[0].threshold = 700;
+		g[1].threshold = 10;
+		g[2].threshold = 10;
+		return g;
+	}();
+	return gens;
+}
+
+HeapStats &
+Heap::stats()
+{
+	static HeapStats heapStats;
+	return heapStats;
+}
+
+const HeapStats &
+Heap::getStats()
+{
+	return stats();
+}
+
+void
+Heap::track(const std::shared_ptr<HeapObject> &object, std::size_t size)
+{
+	HeapStats &s = stats();
+	object->heapSize = size;
+	s.objectsAllocated++;
+	s.objects++;
+	s.bytes += size;
+	if (s.bytes > s.peakBytes)
+	{
+		s.peakBytes = s.bytes;
+	}
+
+	auto &gens = generations();
+	gens[0].objects.push_back(object);
+	gens[0].count++;
+	if (gens[0].count > gens[0].threshold)
+	{
+		int generation = 0;
+		for (int i = GENERATIONS - 1; i > 0; i--)
+		{
+			if (gens[i].count >= gens[i].threshold)
+			{
+				generation = i;
+				break;
+			}
+		}
+		collect(generation);
+	}
+}
+
+void
+Heap::objectFreed(HeapObject *object)
+{
+	HeapStats &s = stats();
+	s.objects--;
+	s.bytes -= object->heapSize;
+}
+
+void
+Heap::collect(int generation)
+{
+	auto start = std::chrono::steady_clock::now();
+	auto &gens = generations();
+
+	// Hold every live object while collecting, so that nothing is freed
+	// until the garbage has been found.
+	std::vector<std::shared_ptr<HeapObject>> objects;
+	for (int i = 0; i <= generation; i++)
+	{
+		for (const auto &weak : gens[i].objects)
+		{
+			std::shared_ptr<HeapObject> object = weak.lock();
+			if (object)
+			{
+				object->collecting = true;
+				object->reachable = false;
+				objects.push_back(object);
+			}
+		}
+		gens[i].objects.clear();
+		gens[i].count = 0;
+	}
+	for (const auto &object : objects)
+	{
+		// Do not count the reference held by objects.
+		object->externalReferences = object.use_count() - 1;
+	}
+
+	// Subtract references from other objects being collected, leaving
+	// only the references from outside.
+	std::vector<HeapObject *> references;
+	for (const auto &object : objects)
+	{
+		references.clear();
+		object->traceReferences(references);
+		for (HeapObject *reference : references)
+		{
+			if (reference->collecting)
+			{
+				reference->externalReferences--;
+			}
+		}
+	}
+
+	// Mark everything reachable from an object referenced from outside.
+	std::vector<HeapObject *> marking;
+	for (const auto &object : objects)
+	{
+		if (object->externalReferences > 0)
+		{
+			object->reachable = true;
+			marking.push_back(object.get());
+		}
+	}
+	while (!marking.empty())
+	{
+		HeapObject *object = marking.back();
+		marking.pop_back();
+		references.clear();
+		object->traceReferences(references);
+		for (HeapObject *reference : references)
+		{
+			if (reference->collecting && !reference->reachable)
+			{
+				reference->reachable = true;
+				marking.push_back(reference);
+			}
+		}
+	}
+
+	// Survivors move to the next generation, the rest is garbage.
+	int older = std::min(generation + 1, GENERATIONS - 1);
+	std::vector<std::shared_ptr<HeapObject>> garbage;
+	for (const auto &object : objects)
+	{
+		object->collecting = false;
+		if (object->reachable)
+		{
+			gens[older].objects.push_back(object);
+		}
+		else
+		{
+			garbage.push_back(object);
+		}
+	}
+	if (generation + 1 < GENERATIONS)
+	{
+		gens[generation + 1].count++;
+	}
+	objects.clear();
+
+	for (const auto &object : garbage)
+	{
+		object->clearReferences();
+	}
+	HeapStats &s = stats();
+	s.objectsCollected += garbage.size();
+	garbage.clear();
+
+	auto pause = std::chrono::steady_clock::now() - start;
+	s.collections[generation]++;
+	s.totalPause += pause;
+	if (pause > s.maxPause)
+	{
+		s.maxPause = pause;
+	}
+}
+
+void
+Heap::printStats()
+{
+	const HeapStats &s = stats();
+	std::wcerr << L"gc cycle collections: " << s.collections[0] << L" generation 0, " <<
+		s.collections[1] << L" generation 1, " <<
+		s.collections[2] << L" generation 2" << std::endl;
+	std::wcerr << L"gc objects allocated: " << s.objectsAllocated <<
+		L", collected as cycles: " << s.objectsCollected << std::endl;
+	std::wcerr << L"gc heap size: " << s.objects << L" objects, " <<
+		s.bytes << L" bytes, peak " << s.peakBytes << L" bytes" << std::endl;
+	std::wcerr << L"gc pause: total " <<
+		std::chrono::duration<double, std::milli>(s.totalPause).count() <<
+		L" ms, max " <<
+		std::chrono::duration<double, std::milli>(s.maxPause).count() <<
+		L" ms" << std::endl;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Base class of objects that can be part of a reference cycle:
+ * environments, functions, classes and instances.
+ */
+class HeapObject
+{
+public:
+	virtual ~HeapObject();
+
+	/*
+	 * Add every heap object that this object holds a std::shared_ptr to.
+	 * Each reference must be added once for each std::shared_ptr held,
+	 * and references that are not owned must not be added.
+	 */
+	virtual void traceReferences(std::vector<HeapObject *> &references);
+
+	/*
+	 * Release all references to other objects, to break a reference
+	 * cycle of garbage.
+	 */
+	virtual void clearReferences();
+
+private:
+	friend class Heap;
+
+	/*
+	 * Size of the object, if it is tracked by the Heap.
+	 */
+	std::size_t heapSize = 0;
+
+	/*
+	 * References from outside the objects being collected.
+	 */
+	long externalReferences = 0;
+
+	bool collecting = false;
+
+	bool reachable = false;
+};
+
+/*
+ * Statistics on garbage collection, for the --gc-stats option.
+ */
+class HeapStats
+{
+public:
+	std::array<std::size_t, 3> collections = {};
+
+	std::size_t objectsAllocated = 0;
+
+	std::size_t objectsCollected = 0;
+
+	/*
+	 * Tracked objects that are still alive, and their size, not
+	 * counting memory they own such as vectors and maps.
+	 */
+	std::size_t objects = 0;
+
+	std::size_t bytes = 0;
+
+	std::size_t peakBytes = 0;
+
+	std::chrono::nanoseconds totalPause = std::chrono::nanoseconds(0);
+
+	std::chrono::nanoseconds maxPause = std::chrono::nanoseconds(0);
+};
+
+/**
+ * Generational cycle collector for heap objects.
+ *
+ * Objects are still owned by std::shared_ptr, so values held by the
+ * interpreter on the C++ stack stay alive without being registered as
+ * roots, and most objects are freed as soon as they are unused. The
+ * collector frees the reference cycles that reference counting cannot.
+ *
+ * A collection finds the references to each object that come from
+ * other objects being collected, by tracing them. Objects with more
+ * references than that are referenced from outside (the interpreter
+ * environment chain and call stack, the VM stack, the syntax tree) and
+ * are roots. Everything reachable from a root is marked, and the
+ * objects left unmarked are garbage and have their references cleared.
+ *
+ * New objects are in generation 0, and objects that survive a
+ * collection move to the next generation. Older generations are
+ * collected less often, as most cycles become garbage while young.
+ */
+class Heap
+{
+public:
+	/*
+	 * Create a new object that is tracked by the collector.
+	 */
+	template <class T, class... Args>
+	static std::shared_ptr<T>
+	allocate(Args&&... args)
+	{
+		std::shared_ptr<T> object = std::make_shared<T>(std::forward<Args>(args)...);
+		track(object, sizeof(T));
+		return object;
+	}
+
+	/*
+	 * Collect the given generation and all younger generations.
+	 */
+	static void collect(int generation);
+
+	static const HeapStats &getStats();
+
+	static void printStats();
+
+private:
+	static const int GENERATIONS = 3;
+
+	friend class HeapObject;
+
+	class Generation
+	{
+	public:
+		std::vector<std::weak_ptr<HeapObject>> objects;
+
+		/*
+		 * Allocations, or collections of the next younger generation,
+		 * since this generation was last collected.
+		 */
+		std::size_t count = 0;
+
+		std::size_t threshold = 0;
+	};
+
+	/*
+	 * State is created on first use, as objects are allocated during
+	 * static initialization of the interpreter.
+	 */
+	static std::array<Generation, GENERATIONS> &generations();
+
+	static HeapStats &stats();
+
+	static void track(const std::shared_ptr<HeapObject> &object, std::size_t size);
+
+	static void objectFreed(HeapObject *object);
+};
@@ -1,78 +1,98 @@
+#include <algorithm>
 #include <sstream>
 #include "interpreter.h"
 #include "runtimeerror.h"
 #include "lox.h"
 #include "clockfunction.h"
 #include "loxfunction.h"
-#include "returnerror.h"
 #include "runtimeerror.h"
 #include "loxclass.h"
 #include "loxinstance.h"
+#include "stringtable.h"
+#include "resolver.h"
+#include "executionstats.h"
 
 Interpreter::Interpreter()
 {
-	globals = std::make_shared<Environment>();
+	globals = Heap::allocate<Environment>();
 	environment = globals;
 
-	globals->define(L"clock", std::make_shared<ClockFunction>());
+	globals->define(StringTable::intern(L"clock"), Value(std::make_shared<ClockFunction>()));
+	globals->define(StringTable::intern(L"nanotime"), Value(std::make_shared<NanoTimeFunction>()));
+	globals->define(StringTable::intern(L"cpuTime"), Value(std::make_shared<CpuTimeFunction>()));
 }
 
-std::any
-Interpreter::visitAssignExpr(std::shared_ptr<Assign> expr)
+Value
+Interpreter::visitAssignExpr(Assign *expr)
 {
-	auto valueExpr = evaluate(expr->m_value);
+	Value value = evaluate(expr->m_value);
 
-	auto it = locals.find(expr);
-	if (it != locals.end())
+	if (expr->m_depth >= 0)
 	{
-		int distance = it->second;
-		environment->assignAt(distance, expr->m_name, valueExpr);
+		environment->assignAt(expr->m_depth, expr->m_slot, value);
+	}
+	else if (expr->m_depth == STACK_DEPTH)
+	{
+		stack[frame + expr->m_slot] = value;
 	}
 	else
 	{
-		globals->assign(expr->m_name, valueExpr);
+		globals->assign(expr->m_name, value);
 	}
-	return valueExpr;
+	return value;
 }
 
-std::any
-Interpreter::visitBlockStmt(std::shared_ptr<Block> stmt)
+Completion
+Interpreter::visitBlockStmt(Block *stmt)
 {
-	executeBlock(stmt->m_statements, std::make_shared<Environment>(environment));
-	return std::make_shared<NilLiteral>();
+	if (stmt->m_locals == 0)
+	{
+		// The resolver gave the block no scope, it runs in the current
+		// environment.
+		for (Stmt *statement : stmt->m_statements)
+		{
+			if (execute(statement) == Completion::RETURN)
+			{
+				return Completion::RETURN;
+			}
+		}
+		return Completion::NORMAL;
+	}
+	return executeBlock(stmt->m_statements,
+		Heap::allocate<Environment>(environment, std::max(stmt->m_locals, 0)));
 }
 
-std::any
-Interpreter::visitClassStmt(std::shared_ptr<Class> stmt)
+Completion
+Interpreter::visitClassStmt(Class *stmt)
 {
 	std::shared_ptr<LoxClass> superclass;
 	if (stmt->m_superclass)
 	{
-		auto expr = evaluate(stmt->m_superclass);
-		superclass = std::dynamic_pointer_cast<LoxClass>(expr);
-		if (!superclass)
+		Value value = evaluate(stmt->m_superclass);
+		if (!value.isObjectType(ObjectType::CLASS))
 		{
 			throw RuntimeError(stmt->m_superclass->m_name,
 				L"Superclass must be a class.");
 		}
+		superclass = value.as<LoxClass>();
 	}
-	environment->define(stmt->m_name->lexeme, std::make_shared<NilLiteral>());
+	std::size_t slot = define(stmt->m_name, Value());
 
 	if (stmt->m_superclass)
 	{
-		environment = std::make_shared<Environment>(environment);
-		environment->define(L"super", superclass);
+		environment = Heap::allocate<Environment>(environment);
+		environment->define(Value(superclass));
 	}
 
-	std::map<std::wstring, std::shared_ptr<LoxFunction>> methods;
-	for (std::shared_ptr<Function> method : stmt->m_methods)
+	std::unordered_map<std::shared_ptr<LoxString>, std::shared_ptr<LoxFunction>> methods;
+	for (Function *method : stmt->m_methods)
 	{
-		bool isInitializer = (method->m_name->lexeme == std::wstring(L"this"));
-		std::shared_ptr<LoxFunction> func = std::make_shared<LoxFunction>(method,
+		bool isInitializer = (method->m_name.lexeme == "init");
+		std::shared_ptr<LoxFunction> func = Heap::allocate<LoxFunction>(method,
 			environment, isInitializer);
-		methods.insert_or_assign(method->m_name->lexeme, func);
+		methods.insert_or_assign(method->m_name.interned, func);
 	}
-	std::shared_ptr<LoxClass> klass = std::make_shared<LoxClass>(stmt->m_name->lexeme,
+	std::shared_ptr<LoxClass> klass = Heap::allocate<LoxClass>(stmt->m_name.text(),
 		superclass, methods);
 
 	if (superclass)
@@ -80,29 +100,37 @@ Interpreter::visitClassStmt(std::shared_ptr<Class> stmt)
 		environment = environment->getEnclosing();
 	}
 
-	environment->assign(stmt->m_name, klass);
-	return std::make_shared<NilLiteral>();
+	if (environment == globals)
+	{
+		globals->assign(stmt->m_name, Value(klass));
+	}
+	else
+	{
+		environment->assignAt(0, slot, Value(klass));
+	}
+	return Completion::NORMAL;
 }
 
-void
-Interpreter::executeBlock(std::vector<std::shared_ptr<Stmt>> statements, std::shared_ptr<Environment> env)
+Completion
+Interpreter::executeBlock(const std::vector<Stmt *> &statements, std::shared_ptr<Environment> env)
 {
 	std::shared_ptr<Environment> previous = environment;
 	try
 	{
 		environment = env;
 
-		for (std::shared_ptr<Stmt> statement : statements)
+		Completion completion = Completion::NORMAL;
+		for (Stmt *statement : statements)
 		{
-			execute(statement);
+			completion = execute(statement);
+			if (completion == Completion::RETURN)
+			{
+				break;
+			}
 		}
 
 		environment = previous;
-	}
-	catch (const ReturnError &e)
-	{
-		environment = previous;
-		throw e;
+		return completion;
 	}
 	catch (const RuntimeError &e)
 	{
@@ -116,178 +144,246 @@ Interpreter::executeBlock(std::vector<std::shared_ptr<Stmt>> statements, std::sh
 	}
 }
 
-std::any
-Interpreter::visitBinaryExpr(std::shared_ptr<Binary> expr)
+Completion
+Interpreter::executeFrame(const std::vector<Stmt *> &statements,
+	std::shared_ptr<Environment> closure, std::size_t frameSize,
+	const std::shared_ptr<LoxInstance> &inst, const std::vector<Value> &arguments)
 {
-	std::shared_ptr<Expr> left = evaluate(expr->m_left);
-	std::shared_ptr<Expr> right = evaluate(expr->m_right);
+	ExecutionStats::count(ExecutionStats::STACK_FRAMES);
+	std::shared_ptr<Environment> previous = environment;
+	std::size_t previousFrame = frame;
+	std::size_t base = stack.size();
+	stack.resize(base + frameSize);
+	std::size_t slot = base;
+	if (inst)
+	{
+		stack[slot++] = Value(inst);
+	}
+	for (const Value &argument : arguments)
+	{
+		stack[slot++] = argument;
+	}
 
-	if (expr->m_operatorX->type == PLUS)
+	environment = closure;
+	frame = base;
+	Completion completion = Completion::NORMAL;
+	try
 	{
-		try
+		for (Stmt *statement : statements)
 		{
-			auto leftString = std::dynamic_pointer_cast<StringLiteral>(left);
-			auto rightString = std::dynamic_pointer_cast<StringLiteral>(right);
-			if (leftString && rightString)
-			{
-				return std::make_shared<StringLiteral>(leftString->m_value + rightString->m_value);
-			}
-
-			auto leftDouble = std::dynamic_pointer_cast<DoubleLiteral>(left);
-			auto rightDouble = std::dynamic_pointer_cast<DoubleLiteral>(right);
-			if (leftDouble && rightDouble)
+			completion = execute(statement);
+			if (completion == Completion::RETURN)
 			{
-				return std::make_shared<DoubleLiteral>(leftDouble->m_value + rightDouble->m_value);
+				break;
 			}
 		}
-		catch (const std::bad_any_cast &e)
-		{
-		}
-		throw RuntimeError(expr->m_operatorX, L"Operands must be two numbers or two strings.");
 	}
-	else
+	catch (...)
 	{
-		if (expr->m_operatorX->type == BANG_EQUAL)
-		{
-			return std::make_shared<BooleanLiteral>(!isEqual(left, right));
-		}
-		else if (expr->m_operatorX->type == EQUAL_EQUAL)
-		{
-			return std::make_shared<BooleanLiteral>(isEqual(left, right));
-		}
+		environment = previous;
+		frame = previousFrame;
+		stack.resize(base);
+		throw;
+	}
+	environment = previous;
+	frame = previousFrame;
+	stack.resize(base);
+	return completion;
+}
 
-		checkNumberOperands(expr->m_operatorX, left, right);
+Value
+Interpreter::visitBinaryExpr(Binary *expr)
+{
+	Value left = evaluate(expr->m_left);
+	Value right = evaluate(expr->m_right);
 
-		auto leftDouble = std::dynamic_pointer_cast<DoubleLiteral>(left);
-		auto rightDouble = std::dynamic_pointer_cast<DoubleLiteral>(right);
+	switch (expr->m_operatorX.type)
+	{
+		case PLUS:
+			if (left.isNumber() && right.isNumber())
+			{
+				return Value(left.asNumber() + right.asNumber());
+			}
+			if (left.isString() && right.isString())
+			{
+				ExecutionStats::count(ExecutionStats::CONCATENATIONS);
+				return Value(StringTable::intern(left.as<LoxString>()->value +
+					right.as<LoxString>()->value));
+			}
+			throw RuntimeError(expr->m_operatorX, L"Operands must be two numbers or two strings.");
+		case BANG_EQUAL:
+			return Value(!left.equals(right));
+		case EQUAL_EQUAL:
+			return Value(left.equals(right));
+		case MINUS:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() - right.asNumber());
+		case SLASH:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() / right.asNumber());
+		case STAR:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() * right.asNumber());
+		case GREATER:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() > right.asNumber());
+		case GREATER_EQUAL:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() >= right.asNumber());
+		case LESS:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() < right.asNumber());
+		case LESS_EQUAL:
+			checkNumberOperands(expr->m_operatorX, left, right);
+			return Value(left.asNumber() <= right.asNumber());
+		default:
+			break;
+	}
 
-		if (expr->m_operatorX->type == MINUS)
-		{
-			return std::make_shared<DoubleLiteral>(leftDouble->m_value - rightDouble->m_value);
-		}
-		else if (expr->m_operatorX->type == SLASH)
-		{
-			return std::make_shared<DoubleLiteral>(leftDouble->m_value / rightDouble->m_value);
-		}
-		else if (expr->m_operatorX->type == STAR)
-		{
-			return std::make_shared<DoubleLiteral>(leftDouble->m_value * rightDouble->m_value);
-		}
-		else if (expr->m_operatorX->type == GREATER)
+	return Value();
+}
+
+Value
+Interpreter::visitCallExpr(Call *expr)
+{
+	Value callee;
+	std::shared_ptr<LoxInstance> inst;
+	std::shared_ptr<LoxFunction> method;
+	if (expr->m_invoke)
+	{
+		// Call methods directly, without creating a bound method. The Get
+		// is not evaluated, so it is counted here.
+		if (ExecutionStats::isEnabled())
 		{
-			return std::make_shared<BooleanLiteral>(leftDouble->m_value > rightDouble->m_value);
+			ExecutionStats::countNode(expr->m_invoke);
 		}
-		else if (expr->m_operatorX->type == GREATER_EQUAL)
+		Value obj = evaluate(expr->m_invoke->m_object);
+		if (!obj.isObjectType(ObjectType::INSTANCE))
 		{
-			return std::make_shared<BooleanLiteral>(leftDouble->m_value >= rightDouble->m_value);
+			throw RuntimeError(expr->m_invoke->m_name, L"Only instances have properties.");
 		}
-		else if (expr->m_operatorX->type == LESS)
+		inst = obj.as<LoxInstance>();
+		method = inst->getMethod(expr->m_invoke->m_name, expr->m_invoke->m_cache);
+		if (method)
 		{
-			return std::make_shared<BooleanLiteral>(leftDouble->m_value < rightDouble->m_value);
+			callee = Value(method);
 		}
-		else if (expr->m_operatorX->type == LESS_EQUAL)
+		else
 		{
-			return std::make_shared<BooleanLiteral>(leftDouble->m_value <= rightDouble->m_value);
+			callee = inst->get(expr->m_invoke->m_name, expr->m_invoke->m_cache);
 		}
 	}
-
-	return std::make_shared<NilLiteral>();
-}
-
-std::any
-Interpreter::visitCallExpr(std::shared_ptr<Call> expr)
-{
-	std::shared_ptr<Expr> callee = evaluate(expr->m_callee);
-
-	std::vector<std::shared_ptr<Expr>> arguments;
-	for (std::shared_ptr<Expr> argument : expr->m_arguments)
+	else
 	{
-		arguments.push_back(castToExpr(evaluate(argument)));
+		callee = evaluate(expr->m_callee);
 	}
 
-	std::shared_ptr<LoxCallable> func;
+	// Calls nest, so their argument lists are reused in the same way
+	// instead of allocating one for each call.
+	if (argumentDepth == argumentLists.size())
+	{
+		argumentLists.emplace_back();
+	}
+	std::vector<Value> &arguments = argumentLists[argumentDepth++];
+	Value result;
 	try
 	{
-		func = std::dynamic_pointer_cast<LoxCallable>(callee);
-		if (!func)
+		for (Expr *argument : expr->m_arguments)
+		{
+			arguments.push_back(evaluate(argument));
+		}
+
+		if (!callee.isCallable())
 		{
 			throw RuntimeError(expr->m_paren, L"Can only call functions and classes.");
 		}
-	}
-	catch (const std::bad_any_cast &e)
-	{
-		throw RuntimeError(expr->m_paren, L"Can only call functions and classes.");
-	}
+		std::shared_ptr<LoxCallable> func = callee.as<LoxCallable>();
+
+		if (arguments.size() != func->arity())
+		{
+			std::wostringstream os;
+			os << L"Expected " << func->arity() << L" arguments but got " <<
+				arguments.size() << L".";
+			throw RuntimeError(expr->m_paren, os.str());
+		}
 
-	if (arguments.size() != func->arity())
+		if (method)
+		{
+			result = method->call(this, arguments, inst);
+		}
+		else
+		{
+			result = func->call(this, arguments);
+		}
+	}
+	catch (...)
 	{
-		std::wostringstream os;
-		os << L"Expected " << func->arity() << L" arguments but got " <<
-			arguments.size() << L".";
-		throw RuntimeError(expr->m_paren, os.str());
+		arguments.clear();
+		argumentDepth--;
+		throw;
 	}
-
-	return func->call(this, arguments);
+	arguments.clear();
+	argumentDepth--;
+	return result;
 }
 
-std::any
-Interpreter::visitGetExpr(std::shared_ptr<Get> expr)
+Value
+Interpreter::visitGetExpr(Get *expr)
 {
-	std::shared_ptr<Expr> obj = evaluate(expr->m_object);
-	std::shared_ptr<LoxInstance> inst = std::dynamic_pointer_cast<LoxInstance>(obj);
-	if (inst)
+	Value obj = evaluate(expr->m_object);
+	if (obj.isObjectType(ObjectType::INSTANCE))
 	{
-		return inst->get(expr->m_name);
+		return obj.as<LoxInstance>()->get(expr->m_name, expr->m_cache);
 	}
 
 	throw RuntimeError(expr->m_name, L"Only instances have properties.");
 }
 
-std::any
-Interpreter::visitGroupingExpr(std::shared_ptr<Grouping> expr)
+Value
+Interpreter::visitGroupingExpr(Grouping *expr)
 {
 	return evaluate(expr->m_expression);
 }
 
-std::any
-Interpreter::visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr)
+Value
+Interpreter::visitDoubleLiteralExpr(DoubleLiteral *expr)
 {
-	return expr;
+	return Value(expr->m_value);
 }
 
-std::any
-Interpreter::visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr)
+Value
+Interpreter::visitStringLiteralExpr(StringLiteral *expr)
 {
-	return expr;
+	return Value(expr->m_value);
 }
 
-std::any
-Interpreter::visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr)
+Value
+Interpreter::visitBooleanLiteralExpr(BooleanLiteral *expr)
 {
-	return expr;
+	return Value(expr->m_value);
 }
 
-std::any
-Interpreter::visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr)
+Value
+Interpreter::visitNilLiteralExpr(NilLiteral *expr)
 {
-	return expr;
+	return Value();
 }
 
-std::any
-Interpreter::visitLogicalExpr(std::shared_ptr<Logical> expr)
+Value
+Interpreter::visitLogicalExpr(Logical *expr)
 {
-	std::shared_ptr<Expr> left = evaluate(expr->m_left);
+	Value left = evaluate(expr->m_left);
 
-	if (expr->m_operatorX->type == TokenType::OR)
+	if (expr->m_operatorX.type == TokenType::OR)
 	{
-		if (isTruthy(left))
+		if (left.isTruthy())
 		{
 			return left;
 		}
 	}
 	else // TOkenType::AND
 	{
-		if (!isTruthy(left))
+		if (!left.isTruthy())
 		{
 			return left;
 		}
@@ -295,83 +391,77 @@ Interpreter::visitLogicalExpr(std::shared_ptr<Logical> expr)
 	return evaluate(expr->m_right);
 }
 
-std::any
-Interpreter::visitSetExpr(std::shared_ptr<Set> expr)
+Value
+Interpreter::visitSetExpr(Set *expr)
 {
-	std::shared_ptr<Expr> obj = evaluate(expr->m_object);
-	std::shared_ptr<LoxInstance> inst = std::dynamic_pointer_cast<LoxInstance>(obj);
-	if (!inst)
+	Value obj = evaluate(expr->m_object);
+	if (!obj.isObjectType(ObjectType::INSTANCE))
 	{
 		throw RuntimeError(expr->m_name, L"Only instances have fields.");
 	}
 
-	std::shared_ptr<Expr> value = evaluate(expr->m_value);
-	inst->set(expr->m_name, value);
+	Value value = evaluate(expr->m_value);
+	obj.as<LoxInstance>()->set(expr->m_name, value, expr->m_cache);
 	return value;
 }
 
-std::any
-Interpreter::visitSuperExpr(std::shared_ptr<Super> expr)
+Value
+Interpreter::visitSuperExpr(Super *expr)
 {
-	int distance = locals.find(expr)->second;
-	std::shared_ptr<Expr> superExpr = environment->getAt(distance, L"super");
-	std::shared_ptr<LoxClass> superclass = std::dynamic_pointer_cast<LoxClass>(superExpr);
+	// "super" and "this" are the only variables in their environments.
+	int distance = expr->m_depth;
+	std::shared_ptr<LoxClass> superclass = environment->getAt(distance, 0).as<LoxClass>();
 
-	std::shared_ptr<Expr> thisExpr = environment->getAt(distance - 1, L"this");
-	std::shared_ptr<LoxInstance> obj = std::dynamic_pointer_cast<LoxInstance>(thisExpr);
+	std::shared_ptr<LoxInstance> obj = environment->getAt(distance - 1, 0).as<LoxInstance>();
 
-	std::shared_ptr<LoxFunction> method = superclass->findMethod(expr->m_method->lexeme);
+	std::shared_ptr<LoxFunction> method = superclass->findMethod(expr->m_method.interned);
 	if (!method)
 	{
 		throw RuntimeError(expr->m_method,
-			L"Undefined property '" + expr->m_method->lexeme + L"'.");
+			L"Undefined property '" + expr->m_method.text() + L"'.");
 	}
-	return method->bind(obj);
+	return Value(method->bind(obj));
 }
 
-std::any
-Interpreter::visitThisExpr(std::shared_ptr<This> expr)
+Value
+Interpreter::visitThisExpr(This *expr)
 {
-	return lookUpVariable(expr->m_keyword, expr);
+	return lookUpVariable(expr->m_keyword, expr->m_depth, expr->m_slot);
 }
 
-std::any
-Interpreter::visitUnaryExpr(std::shared_ptr<Unary> expr)
+Value
+Interpreter::visitUnaryExpr(Unary *expr)
 {
-	std::shared_ptr<Expr> right = evaluate(expr->m_right);
-	if (expr->m_operatorX->type == MINUS)
+	Value right = evaluate(expr->m_right);
+	if (expr->m_operatorX.type == MINUS)
 	{
 		checkNumberOperand(expr->m_operatorX, right);
-		auto ptr = std::dynamic_pointer_cast<DoubleLiteral>(right);
-		if (ptr)
-		{
-			auto neg = std::make_shared<DoubleLiteral>(-ptr->m_value);
-			return neg;
-		}
+		return Value(-right.asNumber());
 	}
-	else if (expr->m_operatorX->type == BANG)
+	else if (expr->m_operatorX.type == BANG)
 	{
-		bool b = isTruthy(right);
-		return std::make_shared<BooleanLiteral>(!b);
+		return Value(!right.isTruthy());
 	}
 
-	return std::make_shared<NilLiteral>();
+	return Value();
 }
 
-std::any
-Interpreter::visitVariableExpr(std::shared_ptr<Variable> expr)
+Value
+Interpreter::visitVariableExpr(Variable *expr)
 {
-	return lookUpVariable(expr->m_name, expr);
+	return lookUpVariable(expr->m_name, expr->m_depth, expr->m_slot);
 }
 
-std::any
-Interpreter::lookUpVariable(std::shared_ptr<Token> name, std::shared_ptr<Expr> expr)
+Value
+Interpreter::lookUpVariable(const Token &name, int depth, int slot)
 {
-	auto it = locals.find(expr);
-	if (it != locals.end())
+	if (depth >= 0)
 	{
-		int distance = it->second;
-		return environment->getAt(distance, name->lexeme);
+		return environment->getAt(depth, slot);
+	}
+	else if (depth == STACK_DEPTH)
+	{
+		return stack[frame + slot];
 	}
 	else
 	{
@@ -379,299 +469,312 @@ Interpreter::lookUpVariable(std::shared_ptr<Token> name, std::shared_ptr<Expr> e
 	}
 }
 
-std::any
-Interpreter::visitFunctionStmt(std::shared_ptr<Function> stmt)
+Completion
+Interpreter::visitFunctionStmt(Function *stmt)
 {
-	std::shared_ptr<LoxFunction> func = std::make_shared<LoxFunction>(stmt, environment, false);
-	environment->define(stmt->m_name->lexeme, func);
-	return std::make_shared<NilLiteral>();
+	std::shared_ptr<LoxFunction> func = Heap::allocate<LoxFunction>(stmt, environment, false);
+	define(stmt->m_name, Value(func));
+	return Completion::NORMAL;
 }
 
-std::any
-Interpreter::visitIfStmt(std::shared_ptr<If> stmt)
+Completion
+Interpreter::visitIfStmt(If *stmt)
 {
-	if (isTruthy(evaluate(stmt->m_condition)))
+	if (evaluate(stmt->m_condition).isTruthy())
 	{
-		execute(stmt->m_thenBranch);
+		return execute(stmt->m_thenBranch);
 	}
 	else if (stmt->m_elseBranch)
 	{
-		execute(stmt->m_elseBranch);
+		return execute(stmt->m_elseBranch);
 	}
-	return nullptr;
+	return Completion::NORMAL;
 }
 
-std::any
-Interpreter::visitPrintStmt(std::shared_ptr<Print> stmt)
+Completion
+Interpreter::visitPrintStmt(Print *stmt)
 {
-	std::shared_ptr<Expr> value = evaluate(stmt->m_expression);
-	std::wcout << stringify(value) << std::endl;
-	return value;
+	Value value = evaluate(stmt->m_expression);
+	std::wcout << value.toString() << std::endl;
+	return Completion::NORMAL;
 }
 
-std::any
-Interpreter::visitReturnStmt(std::shared_ptr<Return> stmt)
+Completion
+Interpreter::visitReturnStmt(Return *stmt)
 {
-	std::shared_ptr<Expr> value;
+	returnValue = Value();
 	if (stmt->m_value)
 	{
-		value = evaluate(stmt->m_value);
+		returnValue = evaluate(stmt->m_value);
 	}
-	throw ReturnError(value);
+	return Completion::RETURN;
 }
 
-std::shared_ptr<Expr>
-Interpreter::castToExpr(std::any value)
+Completion
+Interpreter::visitVarStmt(Var *stmt)
 {
-	try
+	Value value;
+	if (stmt->m_initializer)
 	{
-		// TODO: find a way to do this without trying different data types
-		std::shared_ptr<StringLiteral> s = std::any_cast<std::shared_ptr<StringLiteral>>(value);
-		return s;
+		value = evaluate(stmt->m_initializer);
 	}
-	catch (const std::bad_any_cast &e)
+	if (stmt->m_slot >= 0)
 	{
-		try
-		{
-			std::shared_ptr<DoubleLiteral> d = std::any_cast<std::shared_ptr<DoubleLiteral>>(value);
-			return d;
-		}
-		catch (const std::bad_any_cast &e)
-		{
-			try
-			{
-				std::shared_ptr<BooleanLiteral> b = std::any_cast<std::shared_ptr<BooleanLiteral>>(value);
-				return b;
-			}
-			catch (const std::bad_any_cast &e)
-			{
-				try
-				{
-					std::shared_ptr<NilLiteral> n = std::any_cast<std::shared_ptr<NilLiteral>>(value);
-					return n;
-				}
-				catch (const std::bad_any_cast &e)
-				{
-					try
-					{
-						std::shared_ptr<Expr> expr = std::any_cast<std::shared_ptr<Expr>>(value);
-						return expr;
-					}
-					catch (const std::bad_any_cast &e)
-					{
-						std::shared_ptr<LoxFunction> func = std::any_cast<std::shared_ptr<LoxFunction>>(value);
-						return func;
-					}
-				}
-			}
-		}
-	}
-	return nullptr;
-}
-
-std::any
-Interpreter::visitVarStmt(std::shared_ptr<Var> stmt)
-{
-	if (stmt->m_initializer)
-	{
-		auto expr = evaluate(stmt->m_initializer);
-		environment->define(stmt->m_name->lexeme, expr);
+		stack[frame + stmt->m_slot] = value;
 	}
 	else
 	{
-		environment->define(stmt->m_name->lexeme, std::make_shared<NilLiteral>());
+		define(stmt->m_name, value);
 	}
-	return std::make_shared<NilLiteral>();
+	return Completion::NORMAL;
 }
 
-std::any
-Interpreter::visitWhileStmt(std::shared_ptr<While> stmt)
+/*
+ * A loop of the form for (...; i < limit; i = i + step), where i is
+ * declared by the loop and limit and step are number literals. Its
+ * condition and increment are run without evaluating their syntax trees
+ * while i is a number.
+ */
+class CountedLoop
 {
-	while (isTruthy(evaluate(stmt->m_condition)))
-	{
-		execute(stmt->m_body);
-	}
-	return std::make_shared<NilLiteral>();
-}
+public:
+	int slot = 0;
+
+	/*
+	 * Whether i is on the value stack, rather than in the environment
+	 * of the loop.
+	 */
+	bool stack = false;
+
+	TokenType comparison = LESS;
 
-std::any
-Interpreter::visitExpressionStmt(std::shared_ptr<Expression> stmt)
+	double limit = 0;
+
+	double step = 0;
+};
+
+static bool
+isLoopVariable(Expr *expr, int &slot, bool &stack)
 {
-	std::any value = evaluate(stmt->m_expression);
-	return value;
+	Variable *variable = dynamic_cast<Variable *>(expr);
+	if (!variable || (variable->m_depth != 0 && variable->m_depth != STACK_DEPTH))
+	{
+		return false;
+	}
+	slot = variable->m_slot;
+	stack = (variable->m_depth == STACK_DEPTH);
+	return true;
 }
 
-void
-Interpreter::checkNumberOperand(std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> operand)
+static bool
+matchCountedLoop(For *stmt, CountedLoop &loop)
 {
-	try
+	Binary *condition = dynamic_cast<Binary *>(stmt->m_condition);
+	if (!condition || !isLoopVariable(condition->m_left, loop.slot, loop.stack))
 	{
-		std::shared_ptr<DoubleLiteral> d = std::dynamic_pointer_cast<DoubleLiteral>(operand);
-		if (d)
-		{
-			return;
-		}
+		return false;
 	}
-	catch (const std::bad_any_cast &e)
+	loop.comparison = condition->m_operatorX.type;
+	if (loop.comparison != LESS && loop.comparison != LESS_EQUAL &&
+		loop.comparison != GREATER && loop.comparison != GREATER_EQUAL)
 	{
+		return false;
 	}
-	throw RuntimeError(operatorX, L"Operand must be a number.");
-}
+	DoubleLiteral *limit = dynamic_cast<DoubleLiteral *>(condition->m_right);
+	if (!limit)
+	{
+		return false;
+	}
+	loop.limit = limit->m_value;
 
-void
-Interpreter::checkNumberOperands(std::shared_ptr<Token> operatorX,
-	std::shared_ptr<Expr> left,
-	std::shared_ptr<Expr> right)
-{
-	try
+	Assign *increment = dynamic_cast<Assign *>(stmt->m_increment);
+	int depth = loop.stack ? STACK_DEPTH : 0;
+	if (!increment || increment->m_depth != depth || increment->m_slot != loop.slot)
 	{
-		std::dynamic_pointer_cast<DoubleLiteral>(left);
-		std::dynamic_pointer_cast<DoubleLiteral>(right);
-		if (left && right)
-		{
-			return;
-		}
+		return false;
 	}
-	catch (const std::bad_any_cast &e)
+	Binary *sum = dynamic_cast<Binary *>(increment->m_value);
+	int slot;
+	bool stack;
+	if (!sum || !isLoopVariable(sum->m_left, slot, stack) || slot != loop.slot ||
+		stack != loop.stack)
 	{
+		return false;
 	}
-	throw RuntimeError(operatorX, L"Operands must be numbers.");
+	DoubleLiteral *step = dynamic_cast<DoubleLiteral *>(sum->m_right);
+	if (!step)
+	{
+		return false;
+	}
+	if (sum->m_operatorX.type == PLUS)
+	{
+		loop.step = step->m_value;
+	}
+	else if (sum->m_operatorX.type == MINUS)
+	{
+		loop.step = -step->m_value;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
 }
 
-bool
-Interpreter::isTruthy(std::shared_ptr<Expr> n)
+Completion
+Interpreter::visitForStmt(For *stmt)
 {
+	// The variable declared by the initializer has one environment for
+	// the whole loop. A block body still has a new environment for each
+	// iteration, so closures capture the variables declared in it anew.
+	if (stmt->m_locals == 0)
+	{
+		return executeFor(stmt);
+	}
+	std::shared_ptr<Environment> previous = environment;
+	environment = Heap::allocate<Environment>(environment);
 	try
 	{
-		auto nilValue = std::dynamic_pointer_cast<NilLiteral>(n);
-		if (nilValue)
-		{
-			return false;
-		}
-		auto booleanValue = std::dynamic_pointer_cast<BooleanLiteral>(n);
-		if (booleanValue)
-		{
-			return booleanValue->m_value;
-		}
+		Completion completion = executeFor(stmt);
+		environment = previous;
+		return completion;
 	}
-	catch (const std::bad_any_cast &e)
+	catch (...)
 	{
+		environment = previous;
+		throw;
 	}
-	return true;
 }
 
-bool
-Interpreter::isEqual(std::shared_ptr<Expr> a, std::shared_ptr<Expr> b)
+Completion
+Interpreter::executeFor(For *stmt)
 {
-	try
+	if (stmt->m_initializer)
+	{
+		execute(stmt->m_initializer);
+	}
+
+	CountedLoop loop;
+	bool counted = matchCountedLoop(stmt, loop);
+	while (true)
 	{
-		std::shared_ptr<NilLiteral> na = std::dynamic_pointer_cast<NilLiteral>(a);
-		std::shared_ptr<NilLiteral> nb = std::dynamic_pointer_cast<NilLiteral>(b);
-		if (na && nb)
+		if (counted)
 		{
-			return true;
+			const Value &value = loop.stack ? stack[frame + loop.slot] :
+				environment->getAt(0, loop.slot);
+			if (value.isNumber())
+			{
+				double i = value.asNumber();
+				bool more = (loop.comparison == LESS) ? (i < loop.limit) :
+					(loop.comparison == LESS_EQUAL) ? (i <= loop.limit) :
+					(loop.comparison == GREATER) ? (i > loop.limit) :
+					(i >= loop.limit);
+				if (!more)
+				{
+					break;
+				}
+			}
+			else if (!evaluate(stmt->m_condition).isTruthy())
+			{
+				// Not reached, evaluating the condition reports the
+				// error.
+				break;
+			}
 		}
-		else if (na)
+		else if (stmt->m_condition && !evaluate(stmt->m_condition).isTruthy())
 		{
-			return false;
+			break;
 		}
 
-		std::shared_ptr<DoubleLiteral> da = std::dynamic_pointer_cast<DoubleLiteral>(a);
-		std::shared_ptr<DoubleLiteral> db = std::dynamic_pointer_cast<DoubleLiteral>(b);
-		if (da && db)
+		if (execute(stmt->m_body) == Completion::RETURN)
 		{
-			return (da->m_value == db->m_value);
+			return Completion::RETURN;
 		}
 
-		std::shared_ptr<StringLiteral> sa = std::dynamic_pointer_cast<StringLiteral>(a);
-		std::shared_ptr<StringLiteral> sb = std::dynamic_pointer_cast<StringLiteral>(b);
-		if (sa && sb)
+		if (counted)
 		{
-			return (sa->m_value == sb->m_value);
+			const Value &value = loop.stack ? stack[frame + loop.slot] :
+				environment->getAt(0, loop.slot);
+			if (value.isNumber())
+			{
+				Value next(value.asNumber() + loop.step);
+				if (loop.stack)
+				{
+					stack[frame + loop.slot] = next;
+				}
+				else
+				{
+					environment->assignAt(0, loop.slot, next);
+				}
+				continue;
+			}
 		}
-
-		std::shared_ptr<BooleanLiteral> ba = std::dynamic_pointer_cast<BooleanLiteral>(a);
-		std::shared_ptr<BooleanLiteral> bb = std::dynamic_pointer_cast<BooleanLiteral>(b);
-		if (ba && bb)
+		if (stmt->m_increment)
 		{
-			return (ba->m_value == bb->m_value);
+			evaluate(stmt->m_increment);
 		}
 	}
-	catch (const std::bad_any_cast &e)
+	return Completion::NORMAL;
+}
+
+Completion
+Interpreter::visitWhileStmt(While *stmt)
+{
+	while (evaluate(stmt->m_condition).isTruthy())
 	{
+		if (execute(stmt->m_body) == Completion::RETURN)
+		{
+			return Completion::RETURN;
+		}
 	}
-	return false;
+	return Completion::NORMAL;
 }
 
-std::shared_ptr<Expr>
-Interpreter::evaluate(std::shared_ptr<Expr> expr)
+Completion
+Interpreter::visitExpressionStmt(Expression *stmt)
 {
-	std::any result = expr->accept(this);
-	return castToExpr(result);
+	evaluate(stmt->m_expression);
+	return Completion::NORMAL;
 }
 
-std::wstring
-Interpreter::stringify(std::shared_ptr<Expr> n)
+void
+Interpreter::checkNumberOperand(const Token &operatorX, const Value &operand)
 {
-	try
+	if (operand.isNumber())
 	{
-		std::shared_ptr<NilLiteral> n2 = std::dynamic_pointer_cast<NilLiteral>(n);
-		if (n2)
-		{
-			return std::wstring(L"nil");
-		}
-
-		std::shared_ptr<StringLiteral> s = std::dynamic_pointer_cast<StringLiteral>(n);
-		if (s)
-		{
-			return s->m_value;
-		}
-
-		std::shared_ptr<BooleanLiteral> b = std::dynamic_pointer_cast<BooleanLiteral>(n);
-		if (b)
-		{
-			return b->m_value ? std::wstring(L"true") : std::wstring(L"false");
-		}
-
-		std::shared_ptr<DoubleLiteral> d = std::dynamic_pointer_cast<DoubleLiteral>(n);
-		if (d)
-		{
-			std::wostringstream os;
-			os.precision(15);
-			os << d->m_value;
-			return os.str();
-		}
-
-		std::shared_ptr<LoxFunction> f = std::dynamic_pointer_cast<LoxFunction>(n);
-		if (f)
-		{
-			return f->toString();
-		}
-
-		std::shared_ptr<LoxClass> c = std::dynamic_pointer_cast<LoxClass>(n);
-		if (c)
-		{
-			return c->toString();
-		}
+		return;
+	}
+	throw RuntimeError(operatorX, L"Operand must be a number.");
+}
 
-		std::shared_ptr<LoxInstance> i = std::dynamic_pointer_cast<LoxInstance>(n);
-		if (i)
-		{
-			return i->toString();
-		}
+void
+Interpreter::checkNumberOperands(const Token &operatorX,
+	const Value &left,
+	const Value &right)
+{
+	if (left.isNumber() && right.isNumber())
+	{
+		return;
 	}
-	catch (const std::bad_any_cast &e)
+	throw RuntimeError(operatorX, L"Operands must be numbers.");
+}
+
+Value
+Interpreter::evaluate(Expr *expr)
+{
+	if (ExecutionStats::isEnabled())
 	{
+		ExecutionStats::countNode(expr);
 	}
-	return std::wstring(L"");
+	return expr->accept(this);
 }
 
 void
-Interpreter::interpret(std::vector<std::shared_ptr<Stmt>> statements)
+Interpreter::interpret(std::vector<Stmt *> statements)
 {
 	try
 	{
-		for (std::shared_ptr<Stmt> statement :  statements)
+		for (Stmt *statement :  statements)
 		{
 			execute(statement);
 		}
@@ -682,14 +785,31 @@ Interpreter::interpret(std::vector<std::shared_ptr<Stmt>> statements)
 	}
 }
 
-void
-Interpreter::execute(std::shared_ptr<Stmt> stmt)
+Completion
+Interpreter::execute(Stmt *stmt)
 {
-	stmt->accept(this);
+	if (ExecutionStats::isEnabled())
+	{
+		ExecutionStats::countNode(stmt);
+	}
+	return stmt->accept(this);
 }
 
-void
-Interpreter::resolve(std::shared_ptr<Expr> expr, int depth)
+Value
+Interpreter::takeReturnValue()
 {
-	locals.insert_or_assign(expr, depth);
+	Value value = returnValue;
+	returnValue = Value();
+	return value;
+}
+
+std::size_t
+Interpreter::define(const Token &name, const Value &value)
+{
+	if (environment == globals)
+	{
+		globals->define(name.interned, value);
+		return 0;
+	}
+	return environment->define(value);
 }
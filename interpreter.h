@@ -1,95 +1,125 @@
 #pragma once
 
+#include <deque>
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
 
 #include "token.h"
 #include "expr.h"
 #include "stmt.h"
 #include "environment.h"
+#include "value.h"
 
-class Interpreter : public ExprVisitor, public StmtVisitor
+class LoxInstance;
+
+class Interpreter : public ExprVisitor<Value>, public StmtVisitor<Completion>
 {
 public:
 	std::shared_ptr<Environment> globals;
 
 	Interpreter();
 
-	std::any visitAssignExpr(std::shared_ptr<Assign> expr);
+	Value visitAssignExpr(Assign *expr);
+
+	Completion visitBlockStmt(Block *stmt);
+
+	Completion visitClassStmt(Class *stmt);
 
-	std::any visitBlockStmt(std::shared_ptr<Block> stmt);
+	Value visitBinaryExpr(Binary *expr);
 
-	std::any visitClassStmt(std::shared_ptr<Class> stmt);
+	Value visitCallExpr(Call *expr);
 
-	std::any visitBinaryExpr(std::shared_ptr<Binary> expr);
+	Value visitGetExpr(Get *expr);
 
-	std::any visitCallExpr(std::shared_ptr<Call> expr);
+	Value visitGroupingExpr(Grouping *expr);
 
-	std::any visitGetExpr(std::shared_ptr<Get> expr);
+	Value visitDoubleLiteralExpr(DoubleLiteral *expr);
 
-	std::any visitGroupingExpr(std::shared_ptr<Grouping> expr);
+	Value visitStringLiteralExpr(StringLiteral *expr);
 
-	std::any visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr);
+	Value visitBooleanLiteralExpr(BooleanLiteral *expr);
 
-	std::any visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr);
+	Value visitNilLiteralExpr(NilLiteral *expr);
 
-	std::any visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr);
+	Value visitLogicalExpr(Logical *expr);
 
-	std::any visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr);
+	Value visitSetExpr(Set *expr);
 
-	std::any visitLogicalExpr(std::shared_ptr<Logical> expr);
+	Value visitSuperExpr(Super *expr);
 
-	std::any visitSetExpr(std::shared_ptr<Set> expr);
+	Value visitThisExpr(This *expr);
 
-	std::any visitSuperExpr(std::shared_ptr<Super> expr);
+	Value visitUnaryExpr(Unary *expr);
 
-	std::any visitThisExpr(std::shared_ptr<This> expr);
+	Value visitVariableExpr(Variable *expr);
 
-	std::any visitUnaryExpr(std::shared_ptr<Unary> expr);
+	Completion visitIfStmt(If *stmt);
 
-	std::any visitVariableExpr(std::shared_ptr<Variable> expr);
+	Completion visitForStmt(For *stmt);
 
-	std::any visitIfStmt(std::shared_ptr<If> stmt);
+	Completion visitFunctionStmt(Function *stmt);
 
-	std::any visitFunctionStmt(std::shared_ptr<Function> stmt);
+	Completion visitPrintStmt(Print *expr);
 
-	std::any visitPrintStmt(std::shared_ptr<Print> expr);
+	Completion visitReturnStmt(Return *stmt);
 
-	std::any visitReturnStmt(std::shared_ptr<Return> stmt);
+	Completion visitExpressionStmt(Expression *expr);
 
-	std::any visitExpressionStmt(std::shared_ptr<Expression> expr);
+	Completion visitVarStmt(Var *expr);
 
-	std::any visitVarStmt(std::shared_ptr<Var> expr);
+	Completion visitWhileStmt(While *stmt);
 
-	std::any visitWhileStmt(std::shared_ptr<While> stmt);
+	void interpret(std::vector<Stmt *> statements);
 
-	void interpret(std::vector<std::shared_ptr<Stmt>> statements);
+	Completion executeBlock(const std::vector<Stmt *> &statements, std::shared_ptr<Environment> env);
 
-	void executeBlock(std::vector<std::shared_ptr<Stmt>> statements, std::shared_ptr<Environment> env);
+	/*
+	 * Run the body of a function whose locals are on the value stack,
+	 * in a new frame of frameSize slots in the environment of its
+	 * closure. The frame starts with inst, if it is not nullptr, and the
+	 * arguments.
+	 */
+	Completion executeFrame(const std::vector<Stmt *> &statements,
+		std::shared_ptr<Environment> closure, std::size_t frameSize,
+		const std::shared_ptr<LoxInstance> &inst, const std::vector<Value> &arguments);
 
-	void resolve(std::shared_ptr<Expr> expr, int depth);
+	/*
+	 * The value of the last return statement executed.
+	 */
+	Value takeReturnValue();
 
 private:
 	std::shared_ptr<Environment> environment;
-	std::map<std::shared_ptr<Expr>, int> locals;
+	Value returnValue;
 
-	std::shared_ptr<Expr> castToExpr(std::any value);
+	/*
+	 * Locals of functions that no closure captures, in a frame for each
+	 * call that starts at index frame.
+	 */
+	std::vector<Value> stack;
+	std::size_t frame = 0;
 
-	std::shared_ptr<Expr> evaluate(std::shared_ptr<Expr> expr);
+	/*
+	 * Argument lists of the calls in progress, reused by later calls.
+	 */
+	std::deque<std::vector<Value>> argumentLists;
+	std::size_t argumentDepth = 0;
 
-	std::wstring stringify(std::shared_ptr<Expr> n);
+	Value evaluate(Expr *expr);
 
-	bool isEqual(std::shared_ptr<Expr> a, std::shared_ptr<Expr> b);
+	void checkNumberOperand(const Token &operatorX, const Value &operand);
 
-	void checkNumberOperand(std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> operand);
+	void checkNumberOperands(const Token &operatorX, const Value &left, const Value &right);
 
-	void checkNumberOperands(std::shared_ptr<Token> operatorX, std::shared_ptr<Expr> left, std::shared_ptr<Expr> right);
+	Completion execute(Stmt *stmt);
 
-	bool isTruthy(std::shared_ptr<Expr> n);
+	/*
+	 * Run a for loop in the environment created for its variable.
+	 */
+	Completion executeFor(For *stmt);
 
-	void execute(std::shared_ptr<Stmt> stmt);
+	Value lookUpVariable(const Token &name, int depth, int slot);
 
-	std::any lookUpVariable(std::shared_ptr<Token> name, std::shared_ptr<Expr> expr);
+	std::size_t define(const Token &name, const Value &value);
 };
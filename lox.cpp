@@ -1,21 +1,78 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
-#include <fstream>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include "lox.h"
 #include "scanner.h"
 #include "parser.h"
 #include "expr.h"
 #include "resolver.h"
+#include "heap.h"
+#include "astcache.h"
+#include "astprinter.h"
+#include "optimizer.h"
+#include "profiler.h"
+#include "executionstats.h"
+#include "utf8.h"
 
-bool Lox::hadError = false;
+thread_local bool Lox::hadError = false;
+thread_local std::wostream *Lox::errorStream = &std::wcerr;
 bool Lox::hadRuntimeError = false;
 Interpreter Lox::interpreter;
 
+void
+Lox::setEngine(Engine _engine)
+{
+	engine = _engine;
+}
+
+void
+Lox::setGcStats(bool _gcStats)
+{
+	gcStats = _gcStats;
+}
+
+void
+Lox::setCache(bool _cache)
+{
+	cache = _cache;
+}
+
+void
+Lox::setOptimize(bool _optimize)
+{
+	optimize = _optimize;
+}
+
+void
+Lox::setDumpAst(bool _dumpAst)
+{
+	dumpAst = _dumpAst;
+}
+
+void
+Lox::setProfile(const std::string &path)
+{
+	profilePath = path;
+}
+
+void
+Lox::setStats(bool _stats)
+{
+	stats = _stats;
+	if (stats)
+	{
+		ExecutionStats::enable();
+	}
+}
+
 void
 Lox::report(int line, const std::wstring &where, const std::wstring &message)
 {
-	std::wcerr << "[line " << line << "] Error" <<
+	*errorStream << "[line " << line << "] Error" <<
 		where << ": " << message << std::endl;
 	hadError = true;
 }
@@ -27,15 +84,15 @@ Lox::error(int line, const std::wstring &message)
 }
 
 void
-Lox::error(std::shared_ptr<Token> token, const std::wstring &message)
+Lox::error(const Token &token, const std::wstring &message)
 {
-	if (token->type == END_OF_FILE)
+	if (token.type == END_OF_FILE)
 	{
-		report(token->line, L" at end", message);
+		report(token.line, L" at end", message);
 	}
 	else
 	{
-		report(token->line, L" at '" + token->lexeme + L"'", message);
+		report(token.line, L" at '" + token.text() + L"'", message);
 	}
 }
 
@@ -43,17 +100,143 @@ void
 Lox::runtimeError(const RuntimeError &error)
 {
 	std::wcerr << error.what() << std::endl;
-	std::wcerr << "[line " << error.token->line << "]" << std::endl;
+	std::wcerr << "[line " << error.line << "]" << std::endl;
 	hadRuntimeError = true;
 }
 
+ParsedSource
+Lox::parse(std::unique_ptr<SourceFile> source)
+{
+	// Collect the syntax errors of this source, as sources may be parsed
+	// concurrently and their errors are reported in order.
+	std::wostringstream errors;
+	errorStream = &errors;
+	hadError = false;
+
+	ParsedSource parsed;
+	Scanner scanner(source->bytes());
+	TokenBuffer tokens = scanner.scanTokens();
+	parsed.arena = std::make_unique<Arena>();
+	Parser parser(std::move(tokens), *parsed.arena);
+	parsed.statements = parser.parse();
+	parsed.source = std::move(source);
+	parsed.errors = errors.str();
+	parsed.hadError = hadError;
+
+	errorStream = &std::wcerr;
+	hadError = false;
+	return parsed;
+}
+
+ParsedSource
+Lox::load(const char *path, std::unique_ptr<SourceFile> source, bool useCache)
+{
+	if (useCache)
+	{
+		ParsedSource parsed;
+		parsed.arena = std::make_unique<Arena>();
+		parsed.source = AstCache::load(path, *source, *parsed.arena,
+			parsed.statements);
+		if (parsed.source)
+		{
+			parsed.cached = true;
+			return parsed;
+		}
+	}
+	return parse(std::move(source));
+}
+
+void
+Lox::parseAll(const std::vector<char *> &paths,
+	std::vector<std::unique_ptr<SourceFile>> &sources,
+	std::vector<ParsedSource> &parsed)
+{
+	parsed.resize(sources.size());
+	std::atomic<std::size_t> next(0);
+	auto work = [&]()
+	{
+		std::size_t i;
+		while ((i = next++) < sources.size())
+		{
+			parsed[i] = load(paths[i], std::move(sources[i]), cache);
+		}
+	};
+
+	// The calling thread is one of the workers.
+	std::size_t workers = std::min<std::size_t>(sources.size(),
+		std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < workers; i++)
+	{
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void
+Lox::reportErrors(const ParsedSource &parsed)
+{
+	std::wcerr << parsed.errors;
+	if (parsed.hadError)
+	{
+		hadError = true;
+	}
+}
+
 void
-Lox::run(const std::wstring &bytes)
+Lox::resolve(ParsedSource &parsed)
 {
-	Scanner scanner(bytes);
-	auto tokens = scanner.scanTokens();
-	Parser parser(tokens);
-	std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+	Resolver resolver;
+	resolver.resolve(parsed.statements);
+}
+
+void
+Lox::interpret(ParsedSource &parsed)
+{
+	if (optimize)
+	{
+		Optimizer optimizer(*parsed.arena);
+		optimizer.optimize(parsed.statements);
+	}
+
+	if (dumpAst)
+	{
+		AstPrinter printer;
+		for (const auto &statement : parsed.statements)
+		{
+			std::wcout << printer.print(statement) << std::endl;
+		}
+		return;
+	}
+
+	if (engine == Engine::VM)
+	{
+		if (!vm)
+		{
+			vm = std::make_unique<VM>();
+		}
+		vm->interpret(parsed.statements);
+	}
+	else
+	{
+		// Functions keep pointers to their declarations, so the syntax
+		// tree and the source its tokens refer to are kept until the
+		// program finishes.
+		arenas.push_back(std::move(parsed.arena));
+		sources.push_back(std::move(parsed.source));
+		interpreter.interpret(parsed.statements);
+	}
+}
+
+void
+Lox::run(std::unique_ptr<SourceFile> source)
+{
+	ParsedSource parsed = parse(std::move(source));
+	reportErrors(parsed);
 
 	// Stop if there was a syntax error.
 	if (hadError)
@@ -61,57 +244,106 @@ Lox::run(const std::wstring &bytes)
 		return;
 	}
 
-	Resolver resolver(interpreter);
-	resolver.resolve(statements);
+	resolve(parsed);
 
 	if (hadError)
 	{
 		return;
 	}
 
-	interpreter.interpret(statements);
+	interpret(parsed);
 }
 
 void
-Lox::runFile(char *path)
+Lox::runFiles(const std::vector<char *> &paths)
 {
-	std::wifstream f(path);
-	if (f)
+	std::vector<std::unique_ptr<SourceFile>> files;
+	for (char *path : paths)
 	{
 		// Assume UTF-8, anything more complex is difficult to handle
-		f.imbue(std::locale("C.UTF-8"));
+		std::unique_ptr<SourceFile> source = SourceFile::map(path);
+		if (!source)
+		{
+			std::wcerr << "Could not open file \"" << path << "\"." << std::endl;
+			exit(66);
+		}
+		files.push_back(std::move(source));
+	}
 
-		std::wstring bytes;
-		const int bufSize = 512;
-		wchar_t buf[bufSize];
-		std::streamsize gcount = 0;
-		do
+	// Scan and parse all files concurrently, then resolve and run them
+	// one after another, as one program.
+	std::vector<ParsedSource> parsed;
+	parseAll(paths, files, parsed);
+	for (const auto &p : parsed)
+	{
+		reportErrors(p);
+	}
+	if (!hadError)
+	{
+		for (auto &p : parsed)
 		{
-			f.read(buf, bufSize);
-			gcount = f.gcount();
-			if (gcount > 0)
+			if (!p.cached)
 			{
-				bytes.insert(bytes.end(), buf, buf + gcount);
+				resolve(p);
 			}
 		}
-		while (gcount > 0);
-
-		run(bytes);
-
-		if (hadError)
+	}
+	if (!hadError && cache)
+	{
+		// Before running, as the interpreter takes the syntax trees.
+		for (std::size_t i = 0; i < parsed.size(); i++)
 		{
-			exit(65);
+			if (!parsed[i].cached)
+			{
+				AstCache::save(paths[i], *parsed[i].source, parsed[i].statements);
+			}
 		}
-		if (hadRuntimeError)
+	}
+	if (!hadError)
+	{
+		// Sample only while running, after the threads that parse have
+		// finished.
+		if (!profilePath.empty())
 		{
-			exit(70);
+			Profiler::start(profilePath);
 		}
+		for (auto &p : parsed)
+		{
+			interpret(p);
+			if (hadRuntimeError)
+			{
+				break;
+			}
+		}
+		Profiler::stop();
+	}
+
+	if (gcStats)
+	{
+		Heap::printStats();
+	}
+	if (stats)
+	{
+		ExecutionStats::print();
+	}
+
+	if (hadError)
+	{
+		exit(65);
+	}
+	if (hadRuntimeError)
+	{
+		exit(70);
 	}
 }
 
 void
 Lox::runPrompt()
 {
+	if (!profilePath.empty())
+	{
+		Profiler::start(profilePath);
+	}
 	while(true)
 	{
 		std::wstring line;
@@ -121,8 +353,18 @@ Lox::runPrompt()
 		{
 			break;
 		}
-		run(line);
+		run(std::make_unique<SourceFile>(encodeUtf8(line)));
 
 		hadError = false;
 	}
+	Profiler::stop();
+
+	if (gcStats)
+	{
+		Heap::printStats();
+	}
+	if (stats)
+	{
+		ExecutionStats::print();
+	}
 }
@@ -1,25 +1,111 @@
 #pragma once
 
+#include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "token.h"
 #include "interpreter.h"
 #include "runtimeerror.h"
+#include "vm.h"
+#include "arena.h"
+#include "sourcefile.h"
+
+/*
+ * Execution engine used to run a program.
+ */
+enum class Engine
+{
+	TREE,
+	VM
+};
+
+/*
+ * A source that has been scanned and parsed, but not yet resolved and
+ * run.
+ */
+class ParsedSource
+{
+public:
+	std::unique_ptr<SourceFile> source;
+
+	std::unique_ptr<Arena> arena;
+
+	std::vector<Stmt *> statements;
+
+	/*
+	 * Syntax errors, to be reported in the order the sources are run.
+	 */
+	std::wstring errors;
+
+	bool hadError = false;
+
+	/*
+	 * Whether the syntax tree was loaded from the cache, and so has
+	 * already been resolved.
+	 */
+	bool cached = false;
+};
 
 class Lox
 {
 public:
+	void setEngine(Engine _engine);
+
+	/*
+	 * Print garbage collector statistics when the program finishes.
+	 */
+	void setGcStats(bool _gcStats);
+
+	/*
+	 * Load and save the resolved syntax trees of scripts in an AstCache.
+	 */
+	void setCache(bool _cache);
+
+	/*
+	 * Rewrite syntax trees with the Optimizer before running them.
+	 */
+	void setOptimize(bool _optimize);
+
+	/*
+	 * Print the syntax trees that would be run, instead of running them.
+	 */
+	void setDumpAst(bool _dumpAst);
+
+	/*
+	 * Sample the scripts run with the Profiler, writing the stacks to
+	 * path.
+	 */
+	void setProfile(const std::string &path);
+
+	/*
+	 * Count the work done by the interpreter with ExecutionStats, and
+	 * print the counts when the program finishes.
+	 */
+	void setStats(bool _stats);
+
 	void runPrompt();
 
-	void runFile(char *path);
+	/*
+	 * Run scripts as one program. They are scanned and parsed
+	 * concurrently, then resolved and run in the order given.
+	 */
+	void runFiles(const std::vector<char *> &paths);
 
 	static void error(int line, const std::wstring &message);
 
-	static void error(std::shared_ptr<Token> token, const std::wstring &message);
+	static void error(const Token &token, const std::wstring &message);
 
 	static void runtimeError(const RuntimeError &error);
 private:
-	static bool hadError;
+	/*
+	 * Errors are reported per thread, so that each thread parsing a
+	 * source collects its own.
+	 */
+	static thread_local bool hadError;
+	static thread_local std::wostream *errorStream;
+
 	static bool hadRuntimeError;
 	static Interpreter interpreter;
 
@@ -27,6 +113,57 @@ private:
 		const std::wstring &message);
 
 
-	void run(const std::wstring &bytes);
+	Engine engine = Engine::TREE;
+
+	bool gcStats = false;
+
+	bool cache = true;
+
+	bool optimize = false;
+
+	bool dumpAst = false;
+
+	std::string profilePath;
+
+	bool stats = false;
+
+	/*
+	 * Created on first use, so that the tree-walking interpreter does not
+	 * pay for the VM stack.
+	 */
+	std::unique_ptr<VM> vm;
+
+	/*
+	 * Syntax trees of the code run by the tree-walking interpreter.
+	 */
+	std::vector<std::unique_ptr<Arena>> arenas;
+
+	/*
+	 * Source code of those syntax trees, which their tokens refer to.
+	 */
+	std::vector<std::unique_ptr<SourceFile>> sources;
+
+	/*
+	 * Scan and parse a source. May be called from several threads.
+	 */
+	static ParsedSource parse(std::unique_ptr<SourceFile> source);
+
+	/*
+	 * Load the syntax tree of a script from the cache, or parse it.
+	 */
+	static ParsedSource load(const char *path, std::unique_ptr<SourceFile> source,
+		bool useCache);
+
+	void parseAll(const std::vector<char *> &paths,
+		std::vector<std::unique_ptr<SourceFile>> &sources,
+		std::vector<ParsedSource> &parsed);
+
+	void reportErrors(const ParsedSource &parsed);
+
+	void resolve(ParsedSource &parsed);
+
+	void interpret(ParsedSource &parsed);
+
+	void run(std::unique_ptr<SourceFile> source);
 
 };
@@ -3,13 +3,19 @@
 #include <memory>
 #include <vector>
 
-#include "expr.h"
+#include "loxobject.h"
+#include "value.h"
 #include "interpreter.h"
 
-class LoxCallable : public Expr
+class LoxCallable : public LoxObject
 {
 public:
+	LoxCallable(ObjectType objectType) :
+		LoxObject(objectType)
+	{
+	}
+
 	virtual std::size_t arity() = 0;
 
-	virtual std::shared_ptr<Expr> call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments) = 0;
+	virtual Value call(Interpreter *interpreter, const std::vector<Value> &arguments) = 0;
 };
@@ -1,31 +1,35 @@
 #include "loxclass.h"
 #include "loxinstance.h"
+#include "stringtable.h"
 
 LoxClass::LoxClass(const std::wstring &_name,
 	std::shared_ptr<LoxClass> _superclass,
-	const std::map<std::wstring, std::shared_ptr<LoxFunction>> &_methods) :
+	const std::unordered_map<std::shared_ptr<LoxString>, std::shared_ptr<LoxFunction>> &_methods) :
+	LoxCallable(ObjectType::CLASS),
 	name(_name),
 	superclass(_superclass),
-	methods(_methods)
+	rootShape(std::make_shared<Shape>())
 {
+	if (superclass)
+	{
+		methods = superclass->methods;
+	}
+	for (const auto &method : _methods)
+	{
+		methods.insert_or_assign(method.first, method.second);
+	}
+	initializer = findMethod(StringTable::intern(L"init"));
 }
 
 std::wstring
-LoxClass::toString() const
+LoxClass::toString()
 {
 	return name;
 }
 
-std::any
-LoxClass::accept(ExprVisitor *visitor)
-{
-	return std::make_shared<NilLiteral>();
-}
-
 std::size_t
 LoxClass::arity()
 {
-	std::shared_ptr<LoxFunction> initializer = findMethod(L"init");
 	if (initializer)
 	{
 		return initializer->arity();
@@ -36,21 +40,20 @@ LoxClass::arity()
 	}
 }
 
-std::shared_ptr<Expr>
-LoxClass::call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments)
+Value
+LoxClass::call(Interpreter *interpreter, const std::vector<Value> &arguments)
 {
-	std::shared_ptr<LoxInstance> instance = std::make_shared<LoxInstance>(shared_from_this());
+	std::shared_ptr<LoxInstance> instance = Heap::allocate<LoxInstance>(shared_from_this());
 
-	std::shared_ptr<LoxFunction> initializer = findMethod(L"init");
 	if (initializer)
 	{
-		initializer->bind(instance)->call(interpreter, arguments);
+		initializer->call(interpreter, arguments, instance);
 	}
-	return instance;
+	return Value(instance);
 }
 
 std::shared_ptr<LoxFunction>
-LoxClass::findMethod(const std::wstring &name)
+LoxClass::findMethod(const std::shared_ptr<LoxString> &name)
 {
 	auto it = methods.find(name);
 	if (it != methods.end())
@@ -58,11 +61,37 @@ LoxClass::findMethod(const std::wstring &name)
 		return it->second;
 	}
 
+	std::shared_ptr<LoxFunction> empty;
+	return empty;
+}
+
+std::shared_ptr<Shape>
+LoxClass::getRootShape()
+{
+	return rootShape;
+}
+
+void
+LoxClass::traceReferences(std::vector<HeapObject *> &references)
+{
 	if (superclass)
 	{
-		return superclass->findMethod(name);
+		references.push_back(superclass.get());
+	}
+	for (const auto &method : methods)
+	{
+		references.push_back(method.second.get());
+	}
+	if (initializer)
+	{
+		references.push_back(initializer.get());
 	}
+}
 
-	std::shared_ptr<LoxFunction> empty;
-	return empty;
+void
+LoxClass::clearReferences()
+{
+	superclass.reset();
+	methods.clear();
+	initializer.reset();
 }
@@ -3,39 +3,66 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
+#include <unordered_map>
 
 /*
  * Solve circular dependency between classes LoxClass, LoxFunction and LoxInstance.
  */
 class LoxFunction;
 
-#include "expr.h"
+#include "value.h"
 #include "loxcallable.h"
 #include "interpreter.h"
 #include "loxfunction.h"
+#include "shape.h"
+#include "loxstring.h"
 
+/**
+ * A class, from Chapter 12.
+ *
+ * Classes do not change after they are declared, so the methods
+ * inherited from the superclass are copied into the method table of the
+ * class when it is created, and each method is found with one lookup
+ * however deep the hierarchy is.
+ */
 class LoxClass : public LoxCallable, public std::enable_shared_from_this<LoxClass>
 {
 public:
 	LoxClass(const std::wstring &_name,
 		std::shared_ptr<LoxClass> _superclass,
-		const std::map<std::wstring, std::shared_ptr<LoxFunction>> &_methods);
-
-	std::wstring toString() const;
+		const std::unordered_map<std::shared_ptr<LoxString>, std::shared_ptr<LoxFunction>> &_methods);
 
-	std::any accept(ExprVisitor *visitor);
+	std::wstring toString();
 
 	std::size_t arity();
 
-	std::shared_ptr<Expr> call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments);
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments);
+
+	std::shared_ptr<LoxFunction> findMethod(const std::shared_ptr<LoxString> &name);
+
+	/*
+	 * The Shape of new instances, with no fields.
+	 */
+	std::shared_ptr<Shape> getRootShape();
 
-	std::shared_ptr<LoxFunction> findMethod(const std::wstring &name);
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
 
 private:
 	std::wstring name;
 
 	std::shared_ptr<LoxClass> superclass;
 
-	std::map<std::wstring, std::shared_ptr<LoxFunction>> methods;
+	/*
+	 * Methods of the class and the ones it inherits.
+	 */
+	std::unordered_map<std::shared_ptr<LoxString>, std::shared_ptr<LoxFunction>> methods;
+
+	std::shared_ptr<Shape> rootShape;
+
+	/*
+	 * The "init" method, or nullptr if there is none.
+	 */
+	std::shared_ptr<LoxFunction> initializer;
 };
@@ -1,12 +1,17 @@
 #include "loxfunction.h"
-#include "returnerror.h"
+#include "interpreter.h"
+#include "profiler.h"
+#include "executionstats.h"
 
-LoxFunction::LoxFunction(std::shared_ptr<Function> _declaration,
+LoxFunction::LoxFunction(Function *_declaration,
 	std::shared_ptr<Environment> _closure,
-	bool _isInitializer) :
+	bool _isInitializer,
+	std::shared_ptr<LoxInstance> _boundThis) :
+	LoxCallable(ObjectType::FUNCTION),
 	declaration(_declaration),
 	closure(_closure),
-	isInitializer(_isInitializer)
+	isInitializer(_isInitializer),
+	boundThis(_boundThis)
 {
 }
 
@@ -16,46 +21,82 @@ LoxFunction::arity()
 	return declaration->m_params.size();
 }
 
-std::shared_ptr<Expr>
-LoxFunction::call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments)
+Value
+LoxFunction::call(Interpreter *interpreter, const std::vector<Value> &arguments)
 {
-	std::shared_ptr<Environment> environment = std::make_shared<Environment>(closure);
-	for (std::size_t i = 0; i < declaration->m_params.size(); i++)
+	return call(interpreter, arguments, boundThis);
+}
+
+Value
+LoxFunction::call(Interpreter *interpreter, const std::vector<Value> &arguments,
+	std::shared_ptr<LoxInstance> inst)
+{
+	Profiler::Call profiled(declaration);
+	Completion completion;
+	if (declaration->m_frameSize >= 0)
 	{
-		environment->define(declaration->m_params.at(i)->lexeme, arguments.at(i));
+		// No closure captures the locals, so they are on the value stack.
+		completion = interpreter->executeFrame(declaration->m_body, closure,
+			declaration->m_frameSize, inst, arguments);
 	}
-	try
+	else
 	{
-		interpreter->executeBlock(declaration->m_body, environment);
+		std::shared_ptr<Environment> environment = Heap::allocate<Environment>(closure);
+		if (inst)
+		{
+			environment->define(Value(inst));
+		}
+		for (std::size_t i = 0; i < declaration->m_params.size(); i++)
+		{
+			environment->define(arguments.at(i));
+		}
+		completion = interpreter->executeBlock(declaration->m_body, environment);
 	}
-	catch (const ReturnError &e)
+	if (completion == Completion::RETURN)
 	{
-		return e.value;
+		Value value = interpreter->takeReturnValue();
+		if (!isInitializer)
+		{
+			return value;
+		}
 	}
 
 	if (isInitializer)
 	{
-		return closure->getAt(0, L"this");
+		return Value(inst);
 	}
-	return std::make_shared<NilLiteral>();
-}
-
-std::any
-LoxFunction::accept(ExprVisitor *visitor)
-{
-	return std::make_shared<NilLiteral>();
+	return Value();
 }
 
 std::wstring
 LoxFunction::toString()
 {
-	return L"<fn " + declaration->m_name->lexeme + L">";
+	return L"<fn " + declaration->m_name.text() + L">";
 }
 
 std::shared_ptr<LoxFunction>
 LoxFunction::bind(std::shared_ptr<LoxInstance> inst)
 {
-	std::shared_ptr<Environment> environment = std::make_shared<Environment>(closure);
-	environment->define(L"this", inst);
-	return std::make_shared<LoxFunction>(declaration, environment, isInitializer);
+	ExecutionStats::count(ExecutionStats::BOUND_METHODS);
+	return Heap::allocate<LoxFunction>(declaration, closure, isInitializer, inst);
+}
+
+void
+LoxFunction::traceReferences(std::vector<HeapObject *> &references)
+{
+	if (closure)
+	{
+		references.push_back(closure.get());
+	}
+	if (boundThis)
+	{
+		references.push_back(boundThis.get());
+	}
+}
+
+void
+LoxFunction::clearReferences()
+{
+	closure.reset();
+	boundThis.reset();
 }
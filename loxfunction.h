@@ -14,23 +14,38 @@ class LoxInstance;
 class LoxFunction : public LoxCallable
 {
 public:
-	LoxFunction(std::shared_ptr<Function> _declaration, std::shared_ptr<Environment> _closure,
-		bool _isInitializer);
+	LoxFunction(Function *_declaration, std::shared_ptr<Environment> _closure,
+		bool _isInitializer, std::shared_ptr<LoxInstance> _boundThis = nullptr);
 
 	std::size_t arity();
 
-	std::shared_ptr<Expr> call(Interpreter *interpreter, std::vector<std::shared_ptr<Expr>> arguments);
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments);
 
-	std::any accept(ExprVisitor *visitor);
+	/*
+	 * Call the function as a method of inst, which is put in slot 0
+	 * of the environment of the call as "this".
+	 */
+	Value call(Interpreter *interpreter, const std::vector<Value> &arguments,
+		std::shared_ptr<LoxInstance> inst);
 
 	std::wstring toString();
 
+	/*
+	 * Method bound to inst, for when a method is used as a value
+	 * instead of being called directly.
+	 */
 	std::shared_ptr<LoxFunction> bind(std::shared_ptr<LoxInstance> inst);
 
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+
 private:
-	std::shared_ptr<Function> declaration;
+	Function *declaration = nullptr;
 
 	std::shared_ptr<Environment> closure;
 
 	bool isInitializer;
+
+	std::shared_ptr<LoxInstance> boundThis;
 };
@@ -1,9 +1,13 @@
 #include "loxinstance.h"
 #include "runtimeerror.h"
+#include "executionstats.h"
 
 LoxInstance::LoxInstance(std::shared_ptr<LoxClass> _klass) :
-	klass(_klass)
+	LoxObject(ObjectType::INSTANCE),
+	klass(_klass),
+	shape(_klass->getRootShape())
 {
+	ExecutionStats::count(ExecutionStats::INSTANCES);
 }
 
 std::wstring
@@ -12,38 +16,104 @@ LoxInstance::toString()
 	return klass->toString() + L" instance";
 }
 
-std::any
-LoxInstance::accept(ExprVisitor *visitor)
+Value
+LoxInstance::get(const Token &name, PropertyCache &cache)
 {
-	return std::make_shared<NilLiteral>();
+	const PropertyCacheEntry &entry = lookup(name, cache);
+	if (entry.slot >= 0)
+	{
+		return fields[entry.slot];
+	}
+	return Value(entry.method->bind(shared_from_this()));
 }
 
-std::size_t
-LoxInstance::arity()
+std::shared_ptr<LoxFunction>
+LoxInstance::getMethod(const Token &name, PropertyCache &cache)
 {
-	return 0;
+	const PropertyCacheEntry &entry = lookup(name, cache);
+	if (entry.slot >= 0)
+	{
+		return nullptr;
+	}
+	return entry.method;
+}
+
+const PropertyCacheEntry &
+LoxInstance::lookup(const Token &name, PropertyCache &cache)
+{
+	const PropertyCacheEntry *cached = cache.find(shape.get());
+	if (cached)
+	{
+		return *cached;
+	}
+
+	PropertyCacheEntry entry;
+	entry.shape = shape;
+	entry.slot = shape->lookup(name.interned);
+	if (entry.slot < 0)
+	{
+		// Methods cannot change after the class is declared, and the
+		// Shape identifies the class, so the method can be cached too.
+		entry.method = klass->findMethod(name.interned);
+		if (!entry.method)
+		{
+			throw RuntimeError(name, L"Undefined property '" + name.text() + L"'.");
+		}
+	}
+	return cache.add(entry);
 }
 
-std::shared_ptr<Expr>
-LoxInstance::get(std::shared_ptr<Token> name)
+void
+LoxInstance::set(const Token &name, const Value &value, PropertyCache &cache)
 {
-	auto it = fields.find(name->lexeme);
-	if (it != fields.end())
+	const PropertyCacheEntry *cached = cache.find(shape.get());
+	if (cached)
 	{
-		return it->second;
+		if (cached->newShape)
+		{
+			shape = cached->newShape;
+			fields.push_back(value);
+		}
+		else
+		{
+			fields[cached->slot] = value;
+		}
+		return;
 	}
 
-	auto method = klass->findMethod(name->lexeme);
-	if (method)
+	PropertyCacheEntry entry;
+	entry.shape = shape;
+	entry.slot = shape->lookup(name.interned);
+	if (entry.slot >= 0)
+	{
+		fields[entry.slot] = value;
+	}
+	else
 	{
-		return method->bind(shared_from_this());
+		entry.slot = fields.size();
+		entry.newShape = shape->addField(name.interned);
+		shape = entry.newShape;
+		fields.push_back(value);
 	}
+	cache.add(entry);
+}
 
-	throw RuntimeError(name, L"Undefined property '" + name->lexeme + L"'.");
+void
+LoxInstance::traceReferences(std::vector<HeapObject *> &references)
+{
+	if (klass)
+	{
+		references.push_back(klass.get());
+	}
+	for (const auto &field : fields)
+	{
+		field.traceReference(references);
+	}
 }
 
 void
-LoxInstance::set(std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
+LoxInstance::clearReferences()
 {
-	fields.insert_or_assign(name->lexeme, value);
+	klass.reset();
+	fields.clear();
 }
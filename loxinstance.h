@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 /*
  * Solve circular dependency between classes LoxClass, LoxFunction and LoxInstance.
@@ -8,29 +9,46 @@
 class LoxClass;
 
 #include "token.h"
-#include "expr.h"
+#include "loxobject.h"
+#include "value.h"
 #include "loxclass.h"
+#include "shape.h"
+#include "propertycache.h"
 
 /**
  * An instance of a class, from Chapter 12.3.
  */
-class LoxInstance : public Expr, public std::enable_shared_from_this<LoxInstance>
+class LoxInstance : public LoxObject, public std::enable_shared_from_this<LoxInstance>
 {
 public:
 	LoxInstance(std::shared_ptr<LoxClass> _klass);
 
 	std::wstring toString();
 
-	std::any accept(ExprVisitor *visitor);
+	/*
+	 * Get property name, using cache to skip the lookup if this
+	 * instance has a Shape that was seen before.
+	 */
+	Value get(const Token &name, PropertyCache &cache);
 
-	std::size_t arity();
+	void set(const Token &name, const Value &value, PropertyCache &cache);
 
-	std::shared_ptr<Expr> get(std::shared_ptr<Token> name);
+	/*
+	 * The method called name, so that it can be called without
+	 * binding it, or nullptr if name is a field.
+	 */
+	std::shared_ptr<LoxFunction> getMethod(const Token &name, PropertyCache &cache);
 
-	void set(std::shared_ptr<Token> name, std::shared_ptr<Expr> value);
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
 
 private:
 	std::shared_ptr<LoxClass> klass;
 
-	std::map<std::wstring, std::shared_ptr<Expr>> fields;
+	const PropertyCacheEntry &lookup(const Token &name, PropertyCache &cache);
+
+	std::shared_ptr<Shape> shape;
+
+	std::vector<Value> fields;
 };
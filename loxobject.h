@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "heap.h"
+
+/*
+ * Kind of heap object held by a Value, so that type checks in the
+ * interpreter are a compare instead of a dynamic_cast.
+ */
+enum class ObjectType
+{
+	STRING,
+	FUNCTION,
+	NATIVE,
+	CLASS,
+	INSTANCE,
+	VM_FUNCTION,
+	VM_CLOSURE,
+	VM_UPVALUE,
+	VM_CLASS,
+	VM_INSTANCE,
+	VM_BOUND_METHOD
+};
+
+/**
+ * Base class of all runtime objects that a Value can point to.
+ */
+class LoxObject : public HeapObject
+{
+public:
+	LoxObject(ObjectType _objectType) :
+		objectType(_objectType)
+	{
+	}
+
+	virtual ~LoxObject()
+	{
+	}
+
+	virtual std::wstring toString() = 0;
+
+	const ObjectType objectType;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "loxobject.h"
+
+/**
+ * A string value created by a string literal or by concatenation.
+ */
+class LoxString : public LoxObject
+{
+public:
+	LoxString(const std::wstring &_value) :
+		LoxObject(ObjectType::STRING),
+		value(_value)
+	{
+	}
+
+	std::wstring toString()
+	{
+		return value;
+	}
+
+	const std::wstring value;
+};
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <vector>
 
 #include "lox.h"
 
@@ -14,14 +16,75 @@ main(int argc, char *argv[])
 	std::wcerr.imbue(std::locale("C.UTF-8"));
 
 	Lox lox;
-	if (argc > 2)
+	std::vector<char *> scripts;
+	bool usage = false;
+	bool vm = false;
+	bool profile = false;
+	bool stats = false;
+	for (int i = 1; i < argc; i++)
 	{
-		std::wcerr << "Usage: " << argv[0] << " [script]" << std::endl;
+		if (strcmp(argv[i], "--engine=tree") == 0)
+		{
+			lox.setEngine(Engine::TREE);
+			vm = false;
+		}
+		else if (strcmp(argv[i], "--engine=vm") == 0)
+		{
+			lox.setEngine(Engine::VM);
+			vm = true;
+		}
+		else if (strcmp(argv[i], "--gc-stats") == 0)
+		{
+			lox.setGcStats(true);
+		}
+		else if (strcmp(argv[i], "--no-cache") == 0)
+		{
+			lox.setCache(false);
+		}
+		else if (strcmp(argv[i], "--stats") == 0)
+		{
+			lox.setStats(true);
+			stats = true;
+		}
+		else if (strcmp(argv[i], "-O") == 0)
+		{
+			lox.setOptimize(true);
+		}
+		else if (strcmp(argv[i], "--dump-ast") == 0)
+		{
+			lox.setDumpAst(true);
+		}
+		else if (strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10] != '\0')
+		{
+			lox.setProfile(argv[i] + 10);
+			profile = true;
+		}
+		else if (argv[i][0] != '-')
+		{
+			scripts.push_back(argv[i]);
+		}
+		else
+		{
+			usage = true;
+		}
+	}
+
+	if (usage)
+	{
+		std::wcerr << "Usage: " << argv[0] << " [--engine=tree|vm] [--gc-stats] [--stats] [--no-cache] [-O] [--dump-ast] [--profile=file.folded] [script ...]" << std::endl;
+		exit(64);
+	}
+	else if ((profile || stats) && vm)
+	{
+		// The profiler and the counters instrument the tree-walking
+		// interpreter.
+		std::wcerr << (profile ? "--profile" : "--stats") <<
+			" is not supported with --engine=vm." << std::endl;
 		exit(64);
 	}
-	else if (argc == 2)
+	else if (!scripts.empty())
 	{
-		lox.runFile(argv[1]);
+		lox.runFiles(scripts);
 	}
 	else
 	{
@@ -0,0 +1,405 @@
+#include "optimizer.h"
+#include "stringtable.h"
+
+Optimizer::Optimizer(Arena &_arena) :
+	arena(_arena)
+{
+}
+
+void
+Optimizer::optimize(std::vector<Stmt *> &statements)
+{
+	std::vector<Stmt *> result;
+	for (const auto &statement : statements)
+	{
+		Stmt *stmt = optimize(statement);
+		if (stmt)
+		{
+			result.push_back(stmt);
+		}
+	}
+	statements = std::move(result);
+}
+
+Expr *
+Optimizer::optimize(Expr *expr)
+{
+	if (expr)
+	{
+		return expr->accept(static_cast<ExprVisitor<Expr *> *>(this));
+	}
+	return expr;
+}
+
+Stmt *
+Optimizer::optimize(Stmt *stmt)
+{
+	if (stmt)
+	{
+		return stmt->accept(static_cast<StmtVisitor<Stmt *> *>(this));
+	}
+	return stmt;
+}
+
+Expr *
+Optimizer::optimizeCondition(Expr *expr)
+{
+	expr = optimize(expr);
+
+	// !!x has the same truthiness as x.
+	Unary *outer = dynamic_cast<Unary *>(expr);
+	if (outer && outer->m_operatorX.type == BANG)
+	{
+		Unary *inner = dynamic_cast<Unary *>(outer->m_right);
+		if (inner && inner->m_operatorX.type == BANG)
+		{
+			return inner->m_right;
+		}
+	}
+	return expr;
+}
+
+Stmt *
+Optimizer::optimizeBody(Stmt *stmt)
+{
+	Stmt *result = optimize(stmt);
+	if (!result)
+	{
+		Block *block = arena.make<Block>(std::vector<Stmt *>());
+		block->m_locals = 0;
+		result = block;
+	}
+	return result;
+}
+
+bool
+Optimizer::literalValue(Expr *expr, Value &value)
+{
+	if (auto d = dynamic_cast<DoubleLiteral *>(expr))
+	{
+		value = Value(d->m_value);
+		return true;
+	}
+	if (auto s = dynamic_cast<StringLiteral *>(expr))
+	{
+		value = Value(s->m_value);
+		return true;
+	}
+	if (auto b = dynamic_cast<BooleanLiteral *>(expr))
+	{
+		value = Value(b->m_value);
+		return true;
+	}
+	if (dynamic_cast<NilLiteral *>(expr))
+	{
+		value = Value();
+		return true;
+	}
+	return false;
+}
+
+Expr *
+Optimizer::literal(const Value &value)
+{
+	if (value.isNumber())
+	{
+		return arena.make<DoubleLiteral>(value.asNumber());
+	}
+	if (value.isBoolean())
+	{
+		return arena.make<BooleanLiteral>(value.asBoolean());
+	}
+	if (value.isString())
+	{
+		return arena.make<StringLiteral>(value.as<LoxString>());
+	}
+	return arena.make<NilLiteral>();
+}
+
+Expr *
+Optimizer::visitAssignExpr(Assign *expr)
+{
+	expr->m_value = optimize(expr->m_value);
+	return expr;
+}
+
+Stmt *
+Optimizer::visitBlockStmt(Block *stmt)
+{
+	optimize(stmt->m_statements);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitClassStmt(Class *stmt)
+{
+	for (const auto &method : stmt->m_methods)
+	{
+		optimize(method->m_body);
+	}
+	return stmt;
+}
+
+Expr *
+Optimizer::visitBinaryExpr(Binary *expr)
+{
+	expr->m_left = optimize(expr->m_left);
+	expr->m_right = optimize(expr->m_right);
+
+	Value left;
+	Value right;
+	if (!literalValue(expr->m_left, left) || !literalValue(expr->m_right, right))
+	{
+		return expr;
+	}
+
+	switch (expr->m_operatorX.type)
+	{
+		case BANG_EQUAL:
+			return literal(Value(!left.equals(right)));
+		case EQUAL_EQUAL:
+			return literal(Value(left.equals(right)));
+		case PLUS:
+			if (left.isString() && right.isString())
+			{
+				return literal(Value(StringTable::intern(
+					left.as<LoxString>()->value + right.as<LoxString>()->value)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	if (!left.isNumber() || !right.isNumber())
+	{
+		return expr;
+	}
+	double a = left.asNumber();
+	double b = right.asNumber();
+	switch (expr->m_operatorX.type)
+	{
+		case GREATER:
+			return literal(Value(a > b));
+		case GREATER_EQUAL:
+			return literal(Value(a >= b));
+		case LESS:
+			return literal(Value(a < b));
+		case LESS_EQUAL:
+			return literal(Value(a <= b));
+		case MINUS:
+			return literal(Value(a - b));
+		case PLUS:
+			return literal(Value(a + b));
+		case SLASH:
+			return literal(Value(a / b));
+		case STAR:
+			return literal(Value(a * b));
+		default:
+			break;
+	}
+	return expr;
+}
+
+Expr *
+Optimizer::visitCallExpr(Call *expr)
+{
+	// The callee is not replaced if invoke points to it.
+	Expr *callee = optimize(expr->m_callee);
+	if (!expr->m_invoke)
+	{
+		expr->m_callee = callee;
+	}
+	for (auto &argument : expr->m_arguments)
+	{
+		argument = optimize(argument);
+	}
+	return expr;
+}
+
+Expr *
+Optimizer::visitGetExpr(Get *expr)
+{
+	expr->m_object = optimize(expr->m_object);
+	return expr;
+}
+
+Stmt *
+Optimizer::visitExpressionStmt(Expression *stmt)
+{
+	stmt->m_expression = optimize(stmt->m_expression);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitForStmt(For *stmt)
+{
+	stmt->m_initializer = optimize(stmt->m_initializer);
+	if (stmt->m_condition)
+	{
+		stmt->m_condition = optimizeCondition(stmt->m_condition);
+
+		Value condition;
+		if (literalValue(stmt->m_condition, condition) && condition.isTruthy())
+		{
+			stmt->m_condition = nullptr;
+		}
+	}
+	stmt->m_increment = optimize(stmt->m_increment);
+	stmt->m_body = optimizeBody(stmt->m_body);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitFunctionStmt(Function *stmt)
+{
+	optimize(stmt->m_body);
+	return stmt;
+}
+
+Expr *
+Optimizer::visitGroupingExpr(Grouping *expr)
+{
+	return optimize(expr->m_expression);
+}
+
+Expr *
+Optimizer::visitDoubleLiteralExpr(DoubleLiteral *expr)
+{
+	return expr;
+}
+
+Expr *
+Optimizer::visitStringLiteralExpr(StringLiteral *expr)
+{
+	return expr;
+}
+
+Expr *
+Optimizer::visitBooleanLiteralExpr(BooleanLiteral *expr)
+{
+	return expr;
+}
+
+Expr *
+Optimizer::visitNilLiteralExpr(NilLiteral *expr)
+{
+	return expr;
+}
+
+Expr *
+Optimizer::visitLogicalExpr(Logical *expr)
+{
+	expr->m_left = optimize(expr->m_left);
+	expr->m_right = optimize(expr->m_right);
+
+	Value left;
+	if (!literalValue(expr->m_left, left))
+	{
+		return expr;
+	}
+	if (expr->m_operatorX.type == OR)
+	{
+		return left.isTruthy() ? expr->m_left : expr->m_right;
+	}
+	return left.isTruthy() ? expr->m_right : expr->m_left;
+}
+
+Expr *
+Optimizer::visitSetExpr(Set *expr)
+{
+	expr->m_object = optimize(expr->m_object);
+	expr->m_value = optimize(expr->m_value);
+	return expr;
+}
+
+Expr *
+Optimizer::visitSuperExpr(Super *expr)
+{
+	return expr;
+}
+
+Expr *
+Optimizer::visitThisExpr(This *expr)
+{
+	return expr;
+}
+
+Stmt *
+Optimizer::visitIfStmt(If *stmt)
+{
+	stmt->m_condition = optimizeCondition(stmt->m_condition);
+
+	Value condition;
+	if (literalValue(stmt->m_condition, condition))
+	{
+		// The branch that runs keeps its own scope, if it is a block.
+		return optimize(condition.isTruthy() ? stmt->m_thenBranch : stmt->m_elseBranch);
+	}
+
+	stmt->m_thenBranch = optimizeBody(stmt->m_thenBranch);
+	stmt->m_elseBranch = optimize(stmt->m_elseBranch);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitPrintStmt(Print *stmt)
+{
+	stmt->m_expression = optimize(stmt->m_expression);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitReturnStmt(Return *stmt)
+{
+	stmt->m_value = optimize(stmt->m_value);
+	return stmt;
+}
+
+Expr *
+Optimizer::visitUnaryExpr(Unary *expr)
+{
+	expr->m_right = optimize(expr->m_right);
+
+	Value right;
+	if (!literalValue(expr->m_right, right))
+	{
+		return expr;
+	}
+	if (expr->m_operatorX.type == BANG)
+	{
+		return literal(Value(!right.isTruthy()));
+	}
+	if (expr->m_operatorX.type == MINUS && right.isNumber())
+	{
+		return literal(Value(-right.asNumber()));
+	}
+	return expr;
+}
+
+Expr *
+Optimizer::visitVariableExpr(Variable *expr)
+{
+	return expr;
+}
+
+Stmt *
+Optimizer::visitVarStmt(Var *stmt)
+{
+	stmt->m_initializer = optimize(stmt->m_initializer);
+	return stmt;
+}
+
+Stmt *
+Optimizer::visitWhileStmt(While *stmt)
+{
+	stmt->m_condition = optimizeCondition(stmt->m_condition);
+
+	Value condition;
+	if (literalValue(stmt->m_condition, condition) && !condition.isTruthy())
+	{
+		return nullptr;
+	}
+
+	stmt->m_body = optimizeBody(stmt->m_body);
+	return stmt;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include "expr.h"
+#include "stmt.h"
+#include "arena.h"
+#include "value.h"
+
+/**
+ * Rewrites a resolved syntax tree before it is run, for the -O option.
+ *
+ * Unary and binary operators and logical expressions whose operands are
+ * literals are replaced by their result, groupings are replaced by the
+ * expression inside them, and if and while statements with a literal
+ * condition are replaced by the branch that would run. Operators whose
+ * operands would be a runtime error are kept, so that the error is still
+ * reported when the code runs.
+ *
+ * New nodes are created in the arena of the tree. Variables keep the
+ * depth and slot computed by the Resolver, as statements that declare
+ * variables are never removed and blocks are kept.
+ */
+class Optimizer : public ExprVisitor<Expr *>, public StmtVisitor<Stmt *>
+{
+public:
+	Optimizer(Arena &_arena);
+
+	void optimize(std::vector<Stmt *> &statements);
+
+	Expr *visitAssignExpr(Assign *expr);
+
+	Stmt *visitBlockStmt(Block *stmt);
+
+	Stmt *visitClassStmt(Class *stmt);
+
+	Expr *visitBinaryExpr(Binary *expr);
+
+	Expr *visitCallExpr(Call *expr);
+
+	Expr *visitGetExpr(Get *expr);
+
+	Stmt *visitExpressionStmt(Expression *stmt);
+
+	Stmt *visitForStmt(For *stmt);
+
+	Stmt *visitFunctionStmt(Function *stmt);
+
+	Expr *visitGroupingExpr(Grouping *expr);
+
+	Expr *visitDoubleLiteralExpr(DoubleLiteral *expr);
+
+	Expr *visitStringLiteralExpr(StringLiteral *expr);
+
+	Expr *visitBooleanLiteralExpr(BooleanLiteral *expr);
+
+	Expr *visitNilLiteralExpr(NilLiteral *expr);
+
+	Expr *visitLogicalExpr(Logical *expr);
+
+	Expr *visitSetExpr(Set *expr);
+
+	Expr *visitSuperExpr(Super *expr);
+
+	Expr *visitThisExpr(This *expr);
+
+	Stmt *visitIfStmt(If *stmt);
+
+	Stmt *visitPrintStmt(Print *stmt);
+
+	Stmt *visitReturnStmt(Return *stmt);
+
+	Expr *visitUnaryExpr(Unary *expr);
+
+	Expr *visitVariableExpr(Variable *expr);
+
+	Stmt *visitVarStmt(Var *stmt);
+
+	Stmt *visitWhileStmt(While *stmt);
+
+private:
+	Arena &arena;
+
+	Expr *optimize(Expr *expr);
+
+	Stmt *optimize(Stmt *stmt);
+
+	/*
+	 * Optimize a condition, where only its truthiness matters.
+	 */
+	Expr *optimizeCondition(Expr *expr);
+
+	/*
+	 * Optimize the body of a statement, which must not be removed.
+	 */
+	Stmt *optimizeBody(Stmt *stmt);
+
+	/*
+	 * Get the value of a literal, returning false if expr is not one.
+	 */
+	static bool literalValue(Expr *expr, Value &value);
+
+	Expr *literal(const Value &value);
+};
@@ -1,15 +1,16 @@
 #include "parser.h"
 #include "lox.h"
 
-Parser::Parser(const std::vector<std::shared_ptr<Token>> &parserTokens) :
-	tokens(parserTokens)
+Parser::Parser(TokenBuffer parserTokens, Arena &_arena) :
+	tokens(std::move(parserTokens)),
+	arena(_arena)
 {
 }
 
-std::vector<std::shared_ptr<Stmt>>
+std::vector<Stmt *>
 Parser::parse()
 {
-	std::vector<std::shared_ptr<Stmt>> statements;
+	std::vector<Stmt *> statements;
 	try
 	{
 		while (!isAtEnd())
@@ -23,7 +24,7 @@ Parser::parse()
 	return statements;
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::declaration()
 {
 	try
@@ -46,41 +47,40 @@ Parser::declaration()
 	catch (const ParseError &e)
 	{
 		synchronize();
-		return std::shared_ptr<Stmt>();
+		return nullptr;
 	}
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::classDeclaration()
 {
-	std::shared_ptr<Token> name = consume(IDENTIFIER, L"Expect a class name.");
+	const Token &name = consume(IDENTIFIER, L"Expect a class name.");
 
-	std::shared_ptr<Variable> superclass;
+	Variable *superclass = nullptr;
 	if (match(LESS))
 	{
 		consume(IDENTIFIER, L"Expect subclass name.");
-		superclass = std::make_shared<Variable>(previous());
+		superclass = arena.make<Variable>(previous());
 	}
 	consume(LEFT_BRACE, L"Expect '{' before class body.");
 
-	std::vector<std::shared_ptr<Function>> methods;
+	std::vector<Function *> methods;
 	while (!check(RIGHT_BRACE) && !isAtEnd())
 	{
-		auto func = functionX(L"method");
-		methods.push_back(std::dynamic_pointer_cast<Function>(func));
+		methods.push_back(functionX(L"method"));
 	}
 
 	consume(RIGHT_BRACE, L"Expect '}' after class body.");
 
-	return std::make_shared<Class>(name, superclass, methods);
+	return arena.make<Class>(name, superclass, methods);
 }
 
-std::shared_ptr<Stmt>
+Function *
 Parser::functionX(const std::wstring &kind)
 {
-	std::shared_ptr<Token> name = consume(IDENTIFIER, L"Expect" + kind + L" name.");
+	const Token &name = consume(IDENTIFIER, L"Expect" + kind + L" name.");
 	consume(LEFT_PAREN, L"Expect '(' after " + kind + L" name.");
-	std::vector<std::shared_ptr<Token>> parameters;
+	std::vector<Token> parameters;
 	if (!check(RIGHT_PAREN))
 	{
 		do
@@ -97,25 +97,25 @@ Parser::functionX(const std::wstring &kind)
 	consume(RIGHT_PAREN, L"Expect ')' after parameters.");
 
 	consume(LEFT_BRACE, L"Expect '{' before body.");
-	std::vector<std::shared_ptr<Stmt>> body = block();
-	return std::make_shared<Function>(name, parameters, body);
+	std::vector<Stmt *> body = block();
+	return arena.make<Function>(name, parameters, body);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::varDeclaration()
 {
-	std::shared_ptr<Token> name = consume(IDENTIFIER, L"Expect variable name.");
+	const Token &name = consume(IDENTIFIER, L"Expect variable name.");
 
-	std::shared_ptr<Expr> initializer;
+	Expr *initializer = nullptr;
 	if (match(EQUAL))
 	{
 		initializer = expression();
 	}
 	consume(SEMICOLON, L"Expect ';' after variable declaration.");
-	return std::make_shared<Var>(name, initializer);
+	return arena.make<Var>(name, initializer);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::statement()
 {
 	if (match(FOR))
@@ -140,16 +140,16 @@ Parser::statement()
 	}
 	if (match(LEFT_BRACE))
 	{
-		return std::make_shared<Block>(block());
+		return arena.make<Block>(block());
 	}
 	return expressionStatement();
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::forStatement()
 {
 	consume(LEFT_PAREN, L"Expect '(' after for.");
-	std::shared_ptr<Stmt> initializer;
+	Stmt *initializer = nullptr;
 	if (match(SEMICOLON))
 	{
 		// No initializer
@@ -163,107 +163,85 @@ Parser::forStatement()
 		initializer = expressionStatement();
 	}
 
-	std::shared_ptr<Expr> condition;
+	Expr *condition = nullptr;
 	if (!check(SEMICOLON))
 	{
 		condition = expression();
 	}
-	else
-	{
-		condition = std::make_shared<BooleanLiteral>(true);
-	}
 	consume(SEMICOLON, L"Expect ';' after loop condition.");
 
-	std::shared_ptr<Expr> increment;
+	Expr *increment = nullptr;
 	if (!check(RIGHT_PAREN))
 	{
 		increment = expression();
 	}
 	consume(RIGHT_PAREN, L"Expect ')' after for clauses.");
 
-	std::shared_ptr<Stmt> body = statement();
-
-	if (increment)
-	{
-		std::vector<std::shared_ptr<Stmt>> statements;
-		statements.push_back(body);
-		statements.push_back(std::make_shared<Expression>(increment));
-		body = std::make_shared<Block>(statements);
-	}
-
-	body = std::make_shared<While>(condition, body);
-
-	if (initializer)
-	{
-		std::vector<std::shared_ptr<Stmt>> statements;
-		statements.push_back(initializer);
-		statements.push_back(body);
-		body = std::make_shared<Block>(statements);
-	}
+	Stmt *body = statement();
 
-	return body;
+	return arena.make<For>(initializer, condition, increment, body);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::ifStatement()
 {
 	consume(LEFT_PAREN, L"Expect '(' after if.");
-	std::shared_ptr<Expr> condition = expression();
+	Expr *condition = expression();
 	consume(RIGHT_PAREN, L"Expect ')' after if condition.");
 
-	std::shared_ptr<Stmt> thenBranch = statement();
-	std::shared_ptr<Stmt> elseBranch;
+	Stmt *thenBranch = statement();
+	Stmt *elseBranch = nullptr;
 	if (match(ELSE))
 	{
 		elseBranch = statement();
 	}
-	return std::make_shared<If>(condition, thenBranch, elseBranch);
+	return arena.make<If>(condition, thenBranch, elseBranch);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::whileStatement()
 {
 	consume(LEFT_PAREN, L"Expect '(' after while.");
-	std::shared_ptr<Expr> condition = expression();
+	Expr *condition = expression();
 	consume(RIGHT_PAREN, L"Expect ')' after if condition.");
 
-	std::shared_ptr<Stmt> body = statement();
-	return std::make_shared<While>(condition, body);
+	Stmt *body = statement();
+	return arena.make<While>(condition, body);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::printStatement()
 {
-	std::shared_ptr<Expr> value = expression();
+	Expr *value = expression();
 	consume(SEMICOLON, L"Expect ';' after value.");
-	return std::make_shared<Print>(value);
+	return arena.make<Print>(value);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::returnStatement()
 {
-	std::shared_ptr<Token> keyword = previous();
-	std::shared_ptr<Expr> value;
+	const Token &keyword = previous();
+	Expr *value = nullptr;
 	if (!check(SEMICOLON))
 	{
 		value = expression();
 	}
 	consume(SEMICOLON, L"Expect ';' after return value.");
-	return std::make_shared<Return>(keyword, value);
+	return arena.make<Return>(keyword, value);
 }
 
-std::shared_ptr<Stmt>
+Stmt *
 Parser::expressionStatement()
 {
-	std::shared_ptr<Expr> value = expression();
+	Expr *value = expression();
 	consume(SEMICOLON, L"Expect ';' after expression.");
-	return std::make_shared<Expression>(value);
+	return arena.make<Expression>(value);
 }
 
-std::vector<std::shared_ptr<Stmt>>
+std::vector<Stmt *>
 Parser::block()
 {
-	std::vector<std::shared_ptr<Stmt>> statements;
+	std::vector<Stmt *> statements;
 
 	while (!check(RIGHT_BRACE) && !isAtEnd())
 	{
@@ -274,38 +252,32 @@ Parser::block()
 	return statements;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::expression()
 {
 	return assignment();
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::assignment()
 {
-	std::shared_ptr<Expr> expr = logicalOr();
+	Expr *expr = logicalOr();
 
 	if (match(EQUAL))
 	{
-		std::shared_ptr<Token> equals = previous();
-		std::shared_ptr<Expr> value = assignment();
+		const Token &equals = previous();
+		Expr *value = assignment();
 
-		try
+		auto variable = dynamic_cast<Variable *>(expr);
+		if (variable)
 		{
-			auto variable = std::dynamic_pointer_cast<Variable>(expr);
-			if (variable)
-			{
-				std::shared_ptr<Token> name = variable->m_name;
-				return std::make_shared<Assign>(name, value);
-			}
-			auto get = std::dynamic_pointer_cast<Get>(expr);
-			if (get)
-			{
-				return std::make_shared<Set>(get->m_object, get->m_name, value);
-			}
+			const Token &name = variable->m_name;
+			return arena.make<Assign>(name, value);
 		}
-		catch (const std::bad_any_cast &e)
+		auto get = dynamic_cast<Get *>(expr);
+		if (get)
 		{
+			return arena.make<Set>(get->m_object, get->m_name, value);
 		}
 
 		error(equals, L"Invalid assignment target.");
@@ -315,58 +287,58 @@ Parser::assignment()
 
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::logicalOr()
 {
-	std::shared_ptr<Expr> expr = logicalAnd();
+	Expr *expr = logicalAnd();
 
 	while (match(OR))
 	{
-		std::shared_ptr<Token> operatorX = previous();
-		std::shared_ptr<Expr> right = logicalAnd();
-		expr = std::make_shared<Logical>(expr, operatorX, right);
+		const Token &operatorX = previous();
+		Expr *right = logicalAnd();
+		expr = arena.make<Logical>(expr, operatorX, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::logicalAnd()
 {
-	std::shared_ptr<Expr> expr = equality();
+	Expr *expr = equality();
 
 	while (match(AND))
 	{
-		std::shared_ptr<Token> operatorX = previous();
-		std::shared_ptr<Expr> right = equality();
-		expr = std::make_shared<Logical>(expr, operatorX, right);
+		const Token &operatorX = previous();
+		Expr *right = equality();
+		expr = arena.make<Logical>(expr, operatorX, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::equality()
 {
-	std::shared_ptr<Expr> expr = comparison();
+	Expr *expr = comparison();
 
-	const std::vector<TokenType> tokenTypes = {
+	static const std::vector<TokenType> tokenTypes = {
 		BANG_EQUAL,
 		EQUAL_EQUAL
 	};
 	while (match(tokenTypes))
 	{
-		std::shared_ptr<Token> op = previous();
-		std::shared_ptr<Expr> right = comparison();
-		expr = std::make_shared<Binary>(expr, op, right);
+		const Token &op = previous();
+		Expr *right = comparison();
+		expr = arena.make<Binary>(expr, op, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::comparison()
 {
-	std::shared_ptr<Expr> expr = term();
+	Expr *expr = term();
 
-	const std::vector<TokenType> tokenTypes = {
+	static const std::vector<TokenType> tokenTypes = {
 		GREATER,
 		GREATER_EQUAL,
 		LESS,
@@ -374,70 +346,70 @@ Parser::comparison()
 	};
 	while (match(tokenTypes))
 	{
-		std::shared_ptr<Token> op = previous();
-		std::shared_ptr<Expr> right = term();
-		expr = std::make_shared<Binary>(expr, op, right);
+		const Token &op = previous();
+		Expr *right = term();
+		expr = arena.make<Binary>(expr, op, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::term()
 {
-	std::shared_ptr<Expr> expr = factor();
+	Expr *expr = factor();
 
-	const std::vector<TokenType> tokenTypes = {
+	static const std::vector<TokenType> tokenTypes = {
 		MINUS,
 		PLUS
 	};
 	while (match(tokenTypes))
 	{
-		std::shared_ptr<Token> op = previous();
-		std::shared_ptr<Expr> right = factor();
-		expr = std::make_shared<Binary>(expr, op, right);
+		const Token &op = previous();
+		Expr *right = factor();
+		expr = arena.make<Binary>(expr, op, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::factor()
 {
-	std::shared_ptr<Expr> expr = unary();
+	Expr *expr = unary();
 
-	const std::vector<TokenType> tokenTypes = {
+	static const std::vector<TokenType> tokenTypes = {
 		SLASH,
 		STAR
 	};
 	while (match(tokenTypes))
 	{
-		std::shared_ptr<Token> op = previous();
-		std::shared_ptr<Expr> right = unary();
-		expr = std::make_shared<Binary>(expr, op, right);
+		const Token &op = previous();
+		Expr *right = unary();
+		expr = arena.make<Binary>(expr, op, right);
 	}
 	return expr;
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::unary()
 {
-	const std::vector<TokenType> tokenTypes = {
+	static const std::vector<TokenType> tokenTypes = {
 		BANG,
 		MINUS
 	};
 	if (match(tokenTypes))
 	{
-		std::shared_ptr<Token> op = previous();
-		std::shared_ptr<Expr> right = unary();
-		return std::make_shared<Unary>(op, right);
+		const Token &op = previous();
+		Expr *right = unary();
+		return arena.make<Unary>(op, right);
 	}
 
 	return call();
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::call()
 {
-	std::shared_ptr<Expr> expr = primary();
+	Expr *expr = primary();
 
 	while (true)
 	{
@@ -447,9 +419,9 @@ Parser::call()
 		}
 		else if (match(DOT))
 		{
-			std::shared_ptr<Token> name = consume(IDENTIFIER,
+			const Token &name = consume(IDENTIFIER,
 				L"Expect property name after '.'.");
-			expr = std::make_shared<Get>(expr, name);
+			expr = arena.make<Get>(expr, name);
 		}
 		else
 		{
@@ -459,10 +431,10 @@ Parser::call()
 	return expr;
 }
 
-std::shared_ptr<Expr>
-Parser::finishCall(std::shared_ptr<Expr> callee)
+Expr *
+Parser::finishCall(Expr *callee)
 {
-	std::vector<std::shared_ptr<Expr>> arguments;
+	std::vector<Expr *> arguments;
 	if (!check(RIGHT_PAREN))
 	{
 		do
@@ -476,62 +448,62 @@ Parser::finishCall(std::shared_ptr<Expr> callee)
 		while (match(COMMA));
 	}
 
-	std::shared_ptr<Token> paren = consume(RIGHT_PAREN, L"Expect ')' after arguments.");
-	return std::make_shared<Call>(callee, paren, arguments);
+	const Token &paren = consume(RIGHT_PAREN, L"Expect ')' after arguments.");
+	return arena.make<Call>(callee, paren, arguments);
 }
 
-std::shared_ptr<Expr>
+Expr *
 Parser::primary()
 {
 	if (match(FALSE))
 	{
-		return std::make_shared<BooleanLiteral>(false);
+		return arena.make<BooleanLiteral>(false);
 	}
 	if (match(TRUE))
 	{
-		return std::make_shared<BooleanLiteral>(true);
+		return arena.make<BooleanLiteral>(true);
 	}
 	if (match(NIL))
 	{
-		return std::make_shared<NilLiteral>();
+		return arena.make<NilLiteral>();
 	}
 
 	if (match(STRING))
 	{
-		return std::make_shared<StringLiteral>(previous()->string_literal);
+		return arena.make<StringLiteral>(previous().interned);
 	}
 	if (match(NUMBER))
 	{
-		return std::make_shared<DoubleLiteral>(previous()->double_literal);
+		return arena.make<DoubleLiteral>(previous().double_literal);
 	}
 	if (match(SUPER))
 	{
-		std::shared_ptr<Token> keyword = previous();
+		const Token &keyword = previous();
 		consume(DOT, L"Expect '.' after 'super'.");
-		std::shared_ptr<Token> method = consume(IDENTIFIER,
+		const Token &method = consume(IDENTIFIER,
 			L"Expect superclass method name.");
-		return std::make_shared<Super>(keyword, method);
+		return arena.make<Super>(keyword, method);
 	}
 	if (match(THIS))
 	{
-		return std::make_shared<This>(previous());
+		return arena.make<This>(previous());
 	}
 	if (match(IDENTIFIER))
 	{
-		return std::make_shared<Variable>(previous());
+		return arena.make<Variable>(previous());
 	}
 
 	if (match(LEFT_PAREN))
 	{
-		std::shared_ptr<Expr> expr = expression();
+		Expr *expr = expression();
 		consume(RIGHT_PAREN, L"Expect ')' after expression.");
-		return std::make_shared<Grouping>(expr);
+		return arena.make<Grouping>(expr);
 	}
 
 	throw error(peek(), L"Expect expression.");
 }
 
-std::shared_ptr<Token>
+Token
 Parser::consume(TokenType tokenType, const std::wstring &message)
 {
 	if (check(tokenType))
@@ -543,7 +515,7 @@ Parser::consume(TokenType tokenType, const std::wstring &message)
 }
 
 ParseError
-Parser::error(std::shared_ptr<Token> token, const std::wstring &message)
+Parser::error(const Token &token, const std::wstring &message)
 {
 	Lox::error(token, message);
 	return ParseError(message);
@@ -556,12 +528,12 @@ Parser::synchronize()
 
 	while (!isAtEnd())
 	{
-		if (previous()->type == SEMICOLON)
+		if (tokens.type(current - 1) == SEMICOLON)
 		{
 			return;
 		}
 
-		switch (peek()->type)
+		switch (tokens.type(current))
 		{
 		case CLASS:
 		case FUN:
@@ -587,7 +559,9 @@ Parser::match(const std::vector<TokenType> &tokenTypes)
 	{
 		if (check(tokenType))
 		{
-			advance();
+			// Only the type of a matched token is needed, so skip
+			// creating it with advance().
+			current++;
 			return true;
 		}
 	}
@@ -597,10 +571,12 @@ Parser::match(const std::vector<TokenType> &tokenTypes)
 bool
 Parser::match(TokenType tokenType)
 {
-	const std::vector<TokenType> tokenTypes = {
-		tokenType
-	};
-	return match(tokenTypes);
+	if (check(tokenType))
+	{
+		current++;
+		return true;
+	}
+	return false;
 }
 
 bool
@@ -610,10 +586,10 @@ Parser::check(TokenType tokenType)
 	{
 		return false;
 	}
-	return (peek()->type == tokenType);
+	return (tokens.type(current) == tokenType);
 }
 
-std::shared_ptr<Token>
+Token
 Parser::advance()
 {
 	if (!isAtEnd())
@@ -626,17 +602,17 @@ Parser::advance()
 bool
 Parser::isAtEnd()
 {
-	return (peek()->type == END_OF_FILE);
+	return (tokens.type(current) == END_OF_FILE);
 }
 
-std::shared_ptr<Token>
+Token
 Parser::peek()
 {
-	return tokens.at(current);
+	return tokens.token(current);
 }
 
-std::shared_ptr<Token>
+Token
 Parser::previous()
 {
-	return tokens.at(current - 1);
+	return tokens.token(current - 1);
 }
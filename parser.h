@@ -4,75 +4,81 @@
 #include <vector>
 #include <memory>
 #include "token.h"
+#include "tokenbuffer.h"
 #include "tokentype.h"
 #include "expr.h"
 #include "parseerror.h"
 #include "stmt.h"
+#include "arena.h"
 
 class Parser
 {
 public:
-	Parser(const std::vector<std::shared_ptr<Token>> &parserTokens);
+	/*
+	 * Parse tokens, creating the syntax tree in arena.
+	 */
+	Parser(TokenBuffer parserTokens, Arena &_arena);
 
-	std::vector<std::shared_ptr<Stmt>> parse();
+	std::vector<Stmt *> parse();
 
-	std::shared_ptr<Expr> expression();
+	Expr *expression();
 
-	std::shared_ptr<Expr> assignment();
+	Expr *assignment();
 
-	std::shared_ptr<Expr> logicalOr();
+	Expr *logicalOr();
 
-	std::shared_ptr<Expr> logicalAnd();
+	Expr *logicalAnd();
 
-	std::shared_ptr<Expr> equality();
+	Expr *equality();
 
-	std::shared_ptr<Expr> comparison();
+	Expr *comparison();
 
-	std::shared_ptr<Expr> term();
+	Expr *term();
 
-	std::shared_ptr<Expr> factor();
+	Expr *factor();
 
-	std::shared_ptr<Expr> unary();
+	Expr *unary();
 
-	std::shared_ptr<Expr> call();
+	Expr *call();
 
-	std::shared_ptr<Expr> primary();
+	Expr *primary();
 
-	std::shared_ptr<Token> consume(TokenType tokenType, const std::wstring &message);
+	Token consume(TokenType tokenType, const std::wstring &message);
 
-	ParseError error(std::shared_ptr<Token> token, const std::wstring &message);
+	ParseError error(const Token &token, const std::wstring &message);
 
 	void synchronize();
 
 private:
-	std::vector<std::shared_ptr<Token>> tokens;
-	std::wstring::size_type current = 0;
+	TokenBuffer tokens;
+	std::size_t current = 0;
+	Arena &arena;
 
-	std::shared_ptr<Stmt> declaration();
+	Stmt *declaration();
 
-	std::shared_ptr<Stmt> classDeclaration();
+	Stmt *classDeclaration();
 
-	std::shared_ptr<Stmt> functionX(const std::wstring &kind);
+	Function *functionX(const std::wstring &kind);
 
-	std::shared_ptr<Stmt> varDeclaration();
+	Stmt *varDeclaration();
 
-	std::shared_ptr<Stmt> statement();
+	Stmt *statement();
 
-	std::shared_ptr<Stmt> forStatement();
+	Stmt *forStatement();
 
-	std::shared_ptr<Stmt> ifStatement();
+	Stmt *ifStatement();
 
-	std::shared_ptr<Stmt> whileStatement();
+	Stmt *whileStatement();
 
-	std::shared_ptr<Stmt> printStatement();
+	Stmt *printStatement();
 
-	std::shared_ptr<Stmt> returnStatement();
+	Stmt *returnStatement();
 
-	std::shared_ptr<Stmt> expressionStatement();
+	Stmt *expressionStatement();
 
-	std::vector<std::shared_ptr<Stmt>> block();
+	std::vector<Stmt *> block();
 
-	std::shared_ptr<Expr> finishCall(std::shared_ptr<Expr> callee);
+	Expr *finishCall(Expr *callee);
 
 	bool match(const std::vector<TokenType> &tokenTypes);
 
@@ -80,11 +86,11 @@ private:
 
 	bool check(TokenType tokenType);
 
-	std::shared_ptr<Token> advance();
+	Token advance();
 
 	bool isAtEnd();
 
-	std::shared_ptr<Token> peek();
+	Token peek();
 
-	std::shared_ptr<Token> previous();
+	Token previous();
 };
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "profiler.h"
+#include "utf8.h"
+
+bool Profiler::active = false;
+std::string Profiler::path;
+const Function *Profiler::frames[MAX_DEPTH];
+std::atomic<std::size_t> Profiler::depth(0);
+std::atomic<std::size_t> Profiler::used(0);
+std::atomic<std::size_t> Profiler::dropped(0);
+const Function *Profiler::samples[BUFFER_SIZE];
+std::map<std::vector<const Function *>, std::size_t> Profiler::stacks;
+
+void
+Profiler::start(const std::string &_path)
+{
+	path = _path;
+	active = true;
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, nullptr);
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = SAMPLE_PERIOD / 1000000;
+	timer.it_interval.tv_usec = SAMPLE_PERIOD % 1000000;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void
+Profiler::stop()
+{
+	if (!active)
+	{
+		return;
+	}
+
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, nullptr);
+	signal(SIGPROF, SIG_IGN);
+	active = false;
+	drain();
+
+	std::size_t samples = 0;
+	for (const auto &stack : stacks)
+	{
+		samples += stack.second;
+	}
+	write(samples);
+	printTable(samples);
+}
+
+void
+Profiler::enter(const Function *function)
+{
+	if (used.load(std::memory_order_relaxed) > BUFFER_SIZE / 2)
+	{
+		drain();
+	}
+
+	// The frame is stored before the depth that makes it visible to the
+	// signal handler.
+	std::size_t d = depth.load(std::memory_order_relaxed);
+	if (d < MAX_DEPTH)
+	{
+		frames[d] = function;
+	}
+	std::atomic_signal_fence(std::memory_order_release);
+	depth.store(d + 1, std::memory_order_relaxed);
+}
+
+void
+Profiler::leave()
+{
+	depth.store(depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+void
+Profiler::handleSignal(int signal)
+{
+	std::size_t maxDepth = MAX_DEPTH;
+	std::size_t d = std::min(depth.load(std::memory_order_relaxed), maxDepth);
+	std::atomic_signal_fence(std::memory_order_acquire);
+	std::size_t u = used.load(std::memory_order_relaxed);
+	if (u + d + 1 > BUFFER_SIZE)
+	{
+		dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+		return;
+	}
+
+	// The number of frames is stored as a pointer sized integer.
+	samples[u] = reinterpret_cast<const Function *>(d);
+	std::copy(frames, frames + d, samples + u + 1);
+	used.store(u + d + 1, std::memory_order_relaxed);
+}
+
+void
+Profiler::drain()
+{
+	sigset_t set;
+	sigset_t previous;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPROF);
+	pthread_sigmask(SIG_BLOCK, &set, &previous);
+
+	std::size_t u = used.load(std::memory_order_relaxed);
+	std::size_t i = 0;
+	while (i < u)
+	{
+		std::size_t d = reinterpret_cast<std::size_t>(samples[i]);
+		std::vector<const Function *> stack(samples + i + 1, samples + i + 1 + d);
+		stacks[std::move(stack)]++;
+		i += d + 1;
+	}
+	used.store(0, std::memory_order_relaxed);
+
+	pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+std::wstring
+Profiler::frameName(const Function *function)
+{
+	// Functions are named by their line, as functions and methods in
+	// different classes may have the same name.
+	return function->m_name.text() + L":" + std::to_wstring(function->m_name.line);
+}
+
+void
+Profiler::write(std::size_t samples)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		std::wcerr << "Could not write profile \"" << path.c_str() << "\"." << std::endl;
+		return;
+	}
+
+	// Samples of top-level code have no frames, and are under "script".
+	for (const auto &stack : stacks)
+	{
+		std::wstring line = L"script";
+		for (const Function *function : stack.first)
+		{
+			line += L";" + frameName(function);
+		}
+		std::string bytes = encodeUtf8(line);
+		fprintf(file, "%s %zu\n", bytes.c_str(), stack.second);
+	}
+	fclose(file);
+}
+
+void
+Profiler::printTable(std::size_t samples)
+{
+	// Samples in which each function is running, and in which it is
+	// anywhere on the stack, counted once per sample if it is recursive.
+	std::map<const Function *, std::size_t> self;
+	std::map<const Function *, std::size_t> total;
+	std::size_t script = 0;
+	for (const auto &stack : stacks)
+	{
+		if (stack.first.empty())
+		{
+			script += stack.second;
+			continue;
+		}
+		self[stack.first.back()] += stack.second;
+		std::set<const Function *> seen(stack.first.begin(), stack.first.end());
+		for (const Function *function : seen)
+		{
+			total[function] += stack.second;
+		}
+	}
+
+	std::vector<const Function *> functions;
+	for (const auto &entry : total)
+	{
+		functions.push_back(entry.first);
+	}
+	std::sort(functions.begin(), functions.end(),
+		[&](const Function *a, const Function *b)
+		{
+			if (self[a] != self[b])
+			{
+				return self[a] > self[b];
+			}
+			return total[a] > total[b];
+		});
+
+	// The table is formatted in its own stream, so that the format of
+	// std::wcerr is unchanged for the reports printed after it.
+	std::wostringstream os;
+	os << "Profile: " << samples << " samples, one per " << SAMPLE_PERIOD / 1000 <<
+		" ms of CPU time, written to " << path.c_str();
+	if (dropped > 0)
+	{
+		os << ", " << dropped.load() << " dropped";
+	}
+	os << std::endl;
+	if (samples > 0)
+	{
+		auto percent = [samples](std::size_t count)
+		{
+			return 100.0 * count / samples;
+		};
+		os << std::fixed << std::setprecision(1);
+		os << std::setw(10) << L"self" << std::setw(8) << L"self %" <<
+			std::setw(10) << L"total" << std::setw(9) << L"total %" <<
+			L"  function" << std::endl;
+		for (const Function *function : functions)
+		{
+			os << std::setw(10) << self[function] <<
+				std::setw(8) << percent(self[function]) <<
+				std::setw(10) << total[function] <<
+				std::setw(9) << percent(total[function]) <<
+				L"  " << frameName(function) << std::endl;
+		}
+		os << std::setw(10) << script << std::setw(8) << percent(script) <<
+			std::setw(10) << samples << std::setw(9) << 100.0 <<
+			L"  script" << std::endl;
+	}
+	std::wcerr << os.str();
+}
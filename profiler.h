@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "expr.h"
+#include "stmt.h"
+
+/**
+ * Sampling profiler of Lox scripts run by the tree-walking interpreter,
+ * for the --profile option.
+ *
+ * LoxFunction::call keeps a stack of the functions being called. A
+ * SIGPROF timer interrupts the program every SAMPLE_PERIOD microseconds
+ * of CPU time and the signal handler copies that stack into a
+ * preallocated buffer, without allocating or locking. The buffer is
+ * emptied into a count for each distinct stack when a function is next
+ * called, with the signal blocked.
+ *
+ * When profiling stops, the stacks are written in the collapsed format
+ * read by flamegraph.pl, one line per stack with its frames separated by
+ * ';' and followed by its number of samples. A table of the self and
+ * total samples of each function, and their share of all samples, is
+ * printed to standard error.
+ */
+class Profiler
+{
+public:
+	/*
+	 * Start sampling, to write the stacks to path when stopped.
+	 */
+	static void start(const std::string &path);
+
+	/*
+	 * Stop sampling, write the stacks and print the table.
+	 */
+	static void stop();
+
+	static bool isActive()
+	{
+		return active;
+	}
+
+	/*
+	 * Record a call of a function for as long as the object exists.
+	 * Does nothing if the profiler is not active.
+	 */
+	class Call
+	{
+	public:
+		Call(const Function *function)
+		{
+			if (active)
+			{
+				enter(function);
+				entered = true;
+			}
+		}
+
+		Call(const Call &) = delete;
+
+		Call &operator=(const Call &) = delete;
+
+		~Call()
+		{
+			if (entered)
+			{
+				leave();
+			}
+		}
+
+	private:
+		bool entered = false;
+	};
+
+private:
+	/*
+	 * Microseconds of CPU time between samples. The kernel delivers
+	 * SIGPROF at most once per clock tick, so a shorter period does not
+	 * give proportionally more samples.
+	 */
+	static const long SAMPLE_PERIOD = 10000;
+
+	/*
+	 * Frames deeper than this are counted in the depth of the stack,
+	 * but not sampled.
+	 */
+	static const std::size_t MAX_DEPTH = 256;
+
+	/*
+	 * Entries of the sample buffer. A sample is its number of frames
+	 * followed by the frames.
+	 */
+	static const std::size_t BUFFER_SIZE = 1 << 20;
+
+	static bool active;
+
+	static std::string path;
+
+	static const Function *frames[MAX_DEPTH];
+
+	static std::atomic<std::size_t> depth;
+
+	/*
+	 * Written by the signal handler, so it is not allocated on demand.
+	 */
+	static const Function *samples[BUFFER_SIZE];
+
+	static std::atomic<std::size_t> used;
+
+	static std::atomic<std::size_t> dropped;
+
+	static std::map<std::vector<const Function *>, std::size_t> stacks;
+
+	static void enter(const Function *function);
+
+	static void leave();
+
+	static void handleSignal(int signal);
+
+	/*
+	 * Count the samples in the buffer, and empty it.
+	 */
+	static void drain();
+
+	static std::wstring frameName(const Function *function);
+
+	static void write(std::size_t samples);
+
+	static void printTable(std::size_t samples);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+#include "shape.h"
+
+class LoxFunction;
+
+/*
+ * Result of a property access on an instance with a given Shape.
+ */
+class PropertyCacheEntry
+{
+public:
+	std::shared_ptr<Shape> shape;
+
+	/*
+	 * Index of the field in the instance, or -1 if the property is
+	 * the method.
+	 */
+	int slot = -1;
+
+	std::shared_ptr<LoxFunction> method;
+
+	/*
+	 * For a Set that adds a new field, the Shape of the instance
+	 * after the field is added.
+	 */
+	std::shared_ptr<Shape> newShape;
+};
+
+/**
+ * Polymorphic inline cache stored on each Get and Set node, remembering
+ * the result of the property lookup for the last few Shapes seen.
+ */
+class PropertyCache
+{
+public:
+	static const std::size_t SIZE = 4;
+
+	const PropertyCacheEntry *
+	find(const Shape *shape) const
+	{
+		for (std::size_t i = 0; i < count; i++)
+		{
+			if (entries[i].shape.get() == shape)
+			{
+				return &entries[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/*
+	 * Add an entry, replacing the oldest one when the cache is full.
+	 */
+	const PropertyCacheEntry &
+	add(const PropertyCacheEntry &entry)
+	{
+		if (count < SIZE)
+		{
+			entries[count] = entry;
+			return entries[count++];
+		}
+
+		std::size_t index = next;
+		entries[index] = entry;
+		next = (next + 1) % SIZE;
+		return entries[index];
+	}
+
+private:
+	std::array<PropertyCacheEntry, SIZE> entries;
+
+	std::size_t count = 0;
+
+	std::size_t next = 0;
+};
@@ -1,96 +1,83 @@
+#include <algorithm>
+
 #include "resolver.h"
 #include "lox.h"
 
 ClassType Resolver::currentClass = ClassType::NONE;
 
-Resolver::Resolver(Interpreter &_interpreter) :
-	interpreter(_interpreter)
-{
-}
-
-std::any
-Resolver::visitAssignExpr(std::shared_ptr<Assign> expr)
+void
+Resolver::visitAssignExpr(Assign *expr)
 {
 	resolve(expr->m_value);
-	resolveLocal(expr, expr->m_name);
-	return nullptr;
+	resolveLocal(expr->m_name, expr->m_depth, expr->m_slot);
 }
 
-std::any
-Resolver::visitBinaryExpr(std::shared_ptr<Binary> expr)
+void
+Resolver::visitBinaryExpr(Binary *expr)
 {
 	resolve(expr->m_left);
 	resolve(expr->m_right);
-	return nullptr;
 }
 
-std::any
-Resolver::visitCallExpr(std::shared_ptr<Call> expr)
+void
+Resolver::visitCallExpr(Call *expr)
 {
 	resolve(expr->m_callee);
-	for (std::shared_ptr<Expr> argument : expr->m_arguments)
+	expr->m_invoke = dynamic_cast<Get *>(expr->m_callee);
+	for (Expr *argument : expr->m_arguments)
 	{
 		resolve(argument);
 	}
-	return nullptr;
 }
 
-std::any
-Resolver::visitGetExpr(std::shared_ptr<Get> expr)
+void
+Resolver::visitGetExpr(Get *expr)
 {
 	resolve(expr->m_object);
-	return nullptr;
 }
 
-std::any
-Resolver::visitGroupingExpr(std::shared_ptr<Grouping> expr)
+void
+Resolver::visitGroupingExpr(Grouping *expr)
 {
 	resolve(expr->m_expression);
-	return nullptr;
 }
 
-std::any
-Resolver::visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr)
+void
+Resolver::visitDoubleLiteralExpr(DoubleLiteral *expr)
 {
-	return nullptr;
 }
 
-std::any
-Resolver::visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr)
+void
+Resolver::visitStringLiteralExpr(StringLiteral *expr)
 {
-	return nullptr;
 }
 
-std::any
-Resolver::visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr)
+void
+Resolver::visitBooleanLiteralExpr(BooleanLiteral *expr)
 {
-	return nullptr;
 }
 
-std::any
-Resolver::visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr)
+void
+Resolver::visitNilLiteralExpr(NilLiteral *expr)
 {
-	return nullptr;
 }
 
-std::any
-Resolver::visitLogicalExpr(std::shared_ptr<Logical> expr)
+void
+Resolver::visitLogicalExpr(Logical *expr)
 {
 	resolve(expr->m_left);
 	resolve(expr->m_right);
-	return nullptr;
 }
 
-std::any
-Resolver::visitSetExpr(std::shared_ptr<Set> expr)
+void
+Resolver::visitSetExpr(Set *expr)
 {
 	resolve(expr->m_value);
 	resolve(expr->m_object);
-	return nullptr;
 }
 
-std::any
-Resolver::visitSuperExpr(std::shared_ptr<Super> expr)
+void
+Resolver::visitSuperExpr(Super *expr)
 {
 	if (currentClass == ClassType::NONE)
 	{
@@ -101,38 +88,37 @@ Resolver::visitSuperExpr(std::shared_ptr<Super> expr)
 		Lox::error(expr->m_keyword, L"Can't use 'super' in a class with no superclass.");
 	}
 
-	resolveLocal(expr, expr->m_keyword);
-	return nullptr;
+	// "super" is always in slot 0 of its scope.
+	int slot = 0;
+	resolveLocal(expr->m_keyword, expr->m_depth, slot);
 }
 
-std::any
-Resolver::visitThisExpr(std::shared_ptr<This> expr)
+void
+Resolver::visitThisExpr(This *expr)
 {
 	if (currentClass == ClassType::NONE)
 	{
 		Lox::error(expr->m_keyword, L"Can't use 'this' outside of a class.");
-		return nullptr;
+		return;
 	}
-	resolveLocal(expr, expr->m_keyword);
-	return nullptr;
+	resolveLocal(expr->m_keyword, expr->m_depth, expr->m_slot);
 }
 
-std::any
-Resolver::visitUnaryExpr(std::shared_ptr<Unary> expr)
+void
+Resolver::visitUnaryExpr(Unary *expr)
 {
 	resolve(expr->m_right);
-	return nullptr;
 }
 
-std::any
-Resolver::visitVariableExpr(std::shared_ptr<Variable> expr)
+void
+Resolver::visitVariableExpr(Variable *expr)
 {
 	if (!scopes.empty())
 	{
-		auto it = scopes.back().find(expr->m_name->lexeme);
-		if (it != scopes.back().end())
+		auto it = scopes.back().variables.find(expr->m_name.lexeme);
+		if (it != scopes.back().variables.end())
 		{
-			if (it->second == false)
+			if (!it->second.defined)
 			{
 				Lox::error(expr->m_name,
 					L"Can't read local variable in its own initializer.");
@@ -140,38 +126,34 @@ Resolver::visitVariableExpr(std::shared_ptr<Variable> expr)
 
 		}
 	}
-	resolveLocal(expr, expr->m_name);
-	return nullptr;
+	resolveLocal(expr->m_name, expr->m_depth, expr->m_slot);
 }
 
-std::any
-Resolver::visitIfStmt(std::shared_ptr<If> stmt)
+void
+Resolver::visitIfStmt(If *stmt)
 {
 	resolve(stmt->m_condition);
 	resolve(stmt->m_thenBranch);
 	if (stmt->m_elseBranch)
 		resolve(stmt->m_elseBranch);
-	return nullptr;
 }
 
-std::any
-Resolver::visitFunctionStmt(std::shared_ptr<Function> stmt)
+void
+Resolver::visitFunctionStmt(Function *stmt)
 {
 	declare(stmt->m_name);
 	define(stmt->m_name);
 	resolveFunction(stmt, FunctionType::FUNCTION);
-	return nullptr;
 }
 
-std::any
-Resolver::visitPrintStmt(std::shared_ptr<Print> stmt)
+void
+Resolver::visitPrintStmt(Print *stmt)
 {
 	resolve(stmt->m_expression);
-	return nullptr;
 }
 
-std::any
-Resolver::visitReturnStmt(std::shared_ptr<Return> stmt)
+void
+Resolver::visitReturnStmt(Return *stmt)
 {
 	if (currentFunction == FunctionType::NONE)
 	{
@@ -186,27 +168,94 @@ Resolver::visitReturnStmt(std::shared_ptr<Return> stmt)
 		}
 		resolve(stmt->m_value);
 	}
-	return nullptr;
 }
 
-std::any
-Resolver::visitExpressionStmt(std::shared_ptr<Expression> stmt)
+void
+Resolver::visitExpressionStmt(Expression *stmt)
 {
 	resolve(stmt->m_expression);
-	return nullptr;
 }
 
-std::any
-Resolver::visitBlockStmt(std::shared_ptr<Block> stmt)
+void
+Resolver::visitBlockStmt(Block *stmt)
 {
+	// A block that declares nothing, such as most bodies of if and
+	// while, is resolved in the enclosing scope, so that the interpreter
+	// runs it without a new environment.
+	stmt->m_locals = countDeclarations(stmt->m_statements);
+	if (stmt->m_locals == 0)
+	{
+		resolve(stmt->m_statements);
+		return;
+	}
+
+	// The variables of a block in a frame are on the value stack.
+	if (inFrame)
+	{
+		stmt->m_locals = 0;
+	}
 	beginScope();
 	resolve(stmt->m_statements);
 	endScope();
-	return nullptr;
 }
 
-std::any
-Resolver::visitClassStmt(std::shared_ptr<Class> stmt)
+int
+Resolver::countDeclarations(const std::vector<Stmt *> &statements)
+{
+	int count = 0;
+	for (Stmt *statement : statements)
+	{
+		if (dynamic_cast<Var *>(statement) || dynamic_cast<Function *>(statement) ||
+			dynamic_cast<Class *>(statement))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+bool
+Resolver::declaresFunction(Stmt *stmt)
+{
+	if (dynamic_cast<Function *>(stmt) || dynamic_cast<Class *>(stmt))
+	{
+		return true;
+	}
+	if (auto block = dynamic_cast<Block *>(stmt))
+	{
+		return declaresFunction(block->m_statements);
+	}
+	if (auto ifStmt = dynamic_cast<If *>(stmt))
+	{
+		return declaresFunction(ifStmt->m_thenBranch) ||
+			(ifStmt->m_elseBranch && declaresFunction(ifStmt->m_elseBranch));
+	}
+	if (auto whileStmt = dynamic_cast<While *>(stmt))
+	{
+		return declaresFunction(whileStmt->m_body);
+	}
+	if (auto forStmt = dynamic_cast<For *>(stmt))
+	{
+		return declaresFunction(forStmt->m_body);
+	}
+	return false;
+}
+
+bool
+Resolver::declaresFunction(const std::vector<Stmt *> &statements)
+{
+	for (Stmt *statement : statements)
+	{
+		if (declaresFunction(statement))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+Resolver::visitClassStmt(Class *stmt)
 {
 	ClassType enclosingClass = currentClass;
 	currentClass = ClassType::CLASS;
@@ -215,7 +264,7 @@ Resolver::visitClassStmt(std::shared_ptr<Class> stmt)
 	define(stmt->m_name);
 
 	if (stmt->m_superclass &&
-		stmt->m_name->lexeme == stmt->m_superclass->m_name->lexeme)
+		stmt->m_name.lexeme == stmt->m_superclass->m_name.lexeme)
 	{
 		Lox::error(stmt->m_superclass->m_name, L"A class can't inherit from itself.");
 	}
@@ -229,35 +278,29 @@ Resolver::visitClassStmt(std::shared_ptr<Class> stmt)
 	if (stmt->m_superclass)
 	{
 		beginScope();
-		scopes.back().insert_or_assign(L"super", true);
+		defineName("super");
 	}
 
-	beginScope();
-	scopes.back().insert_or_assign(L"this", true);
-
-	for (std::shared_ptr<Function> method : stmt->m_methods)
+	for (Function *method : stmt->m_methods)
 	{
 		FunctionType declaration = FunctionType::METHOD;
-		if (method->m_name->lexeme == std::wstring(L"init"))
+		if (method->m_name.lexeme == "init")
 		{
 			declaration = FunctionType::INITIALIZER;
 		}
 		resolveFunction(method, declaration);
 	}
 
-	endScope();
-
 	if (stmt->m_superclass)
 	{
 		endScope();
 	}
 
 	currentClass = enclosingClass;
-	return nullptr;
 }
 
-std::any
-Resolver::visitVarStmt(std::shared_ptr<Var> stmt)
+void
+Resolver::visitVarStmt(Var *stmt)
 {
 	declare(stmt->m_name);
 	if (stmt->m_initializer)
@@ -265,19 +308,52 @@ Resolver::visitVarStmt(std::shared_ptr<Var> stmt)
 		resolve(stmt->m_initializer);
 	}
 	define(stmt->m_name);
-	return nullptr;
+
+	if (!scopes.empty() && scopes.back().stack)
+	{
+		stmt->m_slot = scopes.back().variables.at(stmt->m_name.lexeme).slot;
+	}
+}
+
+void
+Resolver::visitForStmt(For *stmt)
+{
+	// The variable declared by the initializer is in a scope around the
+	// whole loop, with an environment unless it is on the value stack.
+	bool scoped = dynamic_cast<Var *>(stmt->m_initializer) != nullptr;
+	stmt->m_locals = (scoped && !inFrame) ? 1 : 0;
+	if (scoped)
+	{
+		beginScope();
+	}
+	if (stmt->m_initializer)
+	{
+		resolve(stmt->m_initializer);
+	}
+	if (stmt->m_condition)
+	{
+		resolve(stmt->m_condition);
+	}
+	if (stmt->m_increment)
+	{
+		resolve(stmt->m_increment);
+	}
+	resolve(stmt->m_body);
+	if (scoped)
+	{
+		endScope();
+	}
 }
 
-std::any
-Resolver::visitWhileStmt(std::shared_ptr<While> stmt)
+void
+Resolver::visitWhileStmt(While *stmt)
 {
 	resolve(stmt->m_condition);
 	resolve(stmt->m_body);
-	return nullptr;
 }
 
 void
-Resolver::resolve(const std::vector<std::shared_ptr<Stmt>> &statements)
+Resolver::resolve(const std::vector<Stmt *> &statements)
 {
 	for (const auto &statement : statements)
 	{
@@ -286,13 +362,13 @@ Resolver::resolve(const std::vector<std::shared_ptr<Stmt>> &statements)
 }
 
 void
-Resolver::resolve(std::shared_ptr<Stmt> statement)
+Resolver::resolve(Stmt *statement)
 {
 	statement->accept(this);
 }
 
 void
-Resolver::resolve(std::shared_ptr<Expr> expr)
+Resolver::resolve(Expr *expr)
 {
 	expr->accept(this);
 }
@@ -300,64 +376,123 @@ Resolver::resolve(std::shared_ptr<Expr> expr)
 void
 Resolver::beginScope()
 {
-	scopes.push_back(std::map<std::wstring, bool>());
+	Scope scope;
+	scope.stack = inFrame;
+	scopes.push_back(std::move(scope));
 }
 
 void
 Resolver::endScope()
 {
+	// Later scopes of the frame reuse the slots of this one.
+	if (scopes.back().stack)
+	{
+		frameSlot -= scopes.back().variables.size();
+	}
 	scopes.pop_back();
 }
 
+int
+Resolver::nextSlot()
+{
+	if (!scopes.back().stack)
+	{
+		return scopes.back().variables.size();
+	}
+	frameSize = std::max(frameSize, frameSlot + 1);
+	return frameSlot++;
+}
+
 void
-Resolver::declare(std::shared_ptr<Token> name)
+Resolver::declare(const Token &name)
 {
 	if (scopes.empty())
 	{
 		return;
 	}
 
-	auto it = scopes.back().find(name->lexeme);
-	if (it != scopes.back().end())
+	auto it = scopes.back().variables.find(name.lexeme);
+	if (it != scopes.back().variables.end())
 	{
 		Lox::error(name, L"Already a variable with this name in this scope.");
+		return;
 	}
-	scopes.back().insert_or_assign(name->lexeme, false);
+
+	// Slots are numbered in order of declaration, the same order as the
+	// Interpreter defines the variables.
+	ScopeVariable variable;
+	variable.slot = nextSlot();
+	scopes.back().variables.insert_or_assign(name.lexeme, variable);
 }
 
 void
-Resolver::define(std::shared_ptr<Token> name)
+Resolver::define(const Token &name)
 {
 	if (scopes.empty())
 	{
 		return;
 	}
 
-	scopes.back().insert_or_assign(name->lexeme, true);
+	scopes.back().variables.at(name.lexeme).defined = true;
 }
 
 void
-Resolver::resolveLocal(std::shared_ptr<Expr> expr, std::shared_ptr<Token> name)
+Resolver::defineName(std::string_view name)
 {
+	ScopeVariable variable;
+	variable.defined = true;
+	variable.slot = nextSlot();
+	scopes.back().variables.insert_or_assign(name, variable);
+}
+
+void
+Resolver::resolveLocal(const Token &name, int &depth, int &slot)
+{
+	// Scopes on the value stack have no environment, and are all in the
+	// frame of the current function, as it has no closures.
+	int environments = 0;
 	for (int i = scopes.size() - 1; i >= 0; i--)
 	{
-		auto it = scopes.at(i).find(name->lexeme);
-		if (it != scopes.at(i).end())
+		auto it = scopes.at(i).variables.find(name.lexeme);
+		if (it != scopes.at(i).variables.end())
 		{
-			interpreter.resolve(expr, scopes.size() - 1 - i);
+			depth = scopes.at(i).stack ? STACK_DEPTH : environments;
+			slot = it->second.slot;
 			return;
 		}
+		if (!scopes.at(i).stack)
+		{
+			environments++;
+		}
 	}
 }
 
 void
-Resolver::resolveFunction(std::shared_ptr<Function> func, FunctionType type)
+Resolver::resolveFunction(Function *func, FunctionType type)
 {
 	FunctionType enclosingFunction = currentFunction;
 	currentFunction = type;
 
+	// The locals of a function that declares no closure are on the value
+	// stack. Methods that may use "super" keep an environment, as "this"
+	// is found from the environment of "super".
+	bool enclosingInFrame = inFrame;
+	int enclosingFrameSlot = frameSlot;
+	int enclosingFrameSize = frameSize;
+	inFrame = !declaresFunction(func->m_body) &&
+		!(type != FunctionType::FUNCTION && currentClass == ClassType::SUBCLASS);
+	frameSlot = 0;
+	frameSize = 0;
+
 	beginScope();
-	for (std::shared_ptr<Token> param : func->m_params)
+
+	// "this" is in slot 0 of the scope of a method, before the parameters.
+	if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER)
+	{
+		defineName("this");
+	}
+
+	for (const Token &param : func->m_params)
 	{
 		declare(param);
 		define(param);
@@ -365,5 +500,10 @@ Resolver::resolveFunction(std::shared_ptr<Function> func, FunctionType type)
 	resolve(func->m_body);
 	endScope();
 
+	func->m_frameSize = inFrame ? frameSize : -1;
+	inFrame = enclosingInFrame;
+	frameSlot = enclosingFrameSlot;
+	frameSize = enclosingFrameSize;
+
 	currentFunction = enclosingFunction;
 }
@@ -1,11 +1,11 @@
 #pragma once
 
 #include <map>
+#include <string_view>
 #include <vector>
 
 #include "expr.h"
 #include "stmt.h"
-#include "interpreter.h"
 
 /*
  * Indicates whether resolver is currently in a function, or not.
@@ -30,83 +30,145 @@ enum class ClassType
 	SUBCLASS
 };
 
+/*
+ * The depth of a variable that is in a slot of the current frame on the
+ * interpreter's value stack.
+ */
+static const int STACK_DEPTH = -2;
+
+/*
+ * A variable declared in a scope, with the slot that holds it in the
+ * environment of the scope at runtime, or in the frame of its function.
+ */
+class ScopeVariable
+{
+public:
+	bool defined = false;
+
+	int slot = 0;
+};
+
+/*
+ * The variables of a scope. A scope of a function whose locals are not
+ * captured by any closure is on the value stack, and has no environment.
+ */
+class Scope
+{
+public:
+	std::map<std::string_view, ScopeVariable> variables;
+
+	bool stack = false;
+};
+
 /**
  * Resolves lox programs, from Chapter 11.
  */
-class Resolver : public ExprVisitor, public StmtVisitor
+class Resolver : public ExprVisitor<void>, public StmtVisitor<void>
 {
 public:
-	Resolver(Interpreter &_interpreter);
+	void visitAssignExpr(Assign *expr);
 
-	std::any visitAssignExpr(std::shared_ptr<Assign> expr);
+	void visitBlockStmt(Block *stmt);
 
-	std::any visitBlockStmt(std::shared_ptr<Block> stmt);
+	void visitClassStmt(Class *stmt);
 
-	std::any visitClassStmt(std::shared_ptr<Class> stmt);
+	void visitBinaryExpr(Binary *expr);
 
-	std::any visitBinaryExpr(std::shared_ptr<Binary> expr);
+	void visitCallExpr(Call *expr);
 
-	std::any visitCallExpr(std::shared_ptr<Call> expr);
+	void visitGetExpr(Get *expr);
 
-	std::any visitGetExpr(std::shared_ptr<Get> expr);
+	void visitGroupingExpr(Grouping *expr);
 
-	std::any visitGroupingExpr(std::shared_ptr<Grouping> expr);
+	void visitDoubleLiteralExpr(DoubleLiteral *expr);
 
-	std::any visitDoubleLiteralExpr(std::shared_ptr<DoubleLiteral> expr);
+	void visitStringLiteralExpr(StringLiteral *expr);
 
-	std::any visitStringLiteralExpr(std::shared_ptr<StringLiteral> expr);
+	void visitBooleanLiteralExpr(BooleanLiteral *expr);
 
-	std::any visitBooleanLiteralExpr(std::shared_ptr<BooleanLiteral> expr);
+	void visitNilLiteralExpr(NilLiteral *expr);
 
-	std::any visitNilLiteralExpr(std::shared_ptr<NilLiteral> expr);
+	void visitLogicalExpr(Logical *expr);
 
-	std::any visitLogicalExpr(std::shared_ptr<Logical> expr);
+	void visitSetExpr(Set *expr);
 
-	std::any visitSetExpr(std::shared_ptr<Set> expr);
+	void visitSuperExpr(Super *expr);
 
-	std::any visitSuperExpr(std::shared_ptr<Super> expr);
+	void visitThisExpr(This *expr);
 
-	std::any visitThisExpr(std::shared_ptr<This> expr);
+	void visitUnaryExpr(Unary *expr);
 
-	std::any visitUnaryExpr(std::shared_ptr<Unary> expr);
+	void visitVariableExpr(Variable *expr);
 
-	std::any visitVariableExpr(std::shared_ptr<Variable> expr);
+	void visitIfStmt(If *stmt);
 
-	std::any visitIfStmt(std::shared_ptr<If> stmt);
+	void visitForStmt(For *stmt);
 
-	std::any visitFunctionStmt(std::shared_ptr<Function> stmt);
+	void visitFunctionStmt(Function *stmt);
 
-	std::any visitPrintStmt(std::shared_ptr<Print> stmt);
+	void visitPrintStmt(Print *stmt);
 
-	std::any visitReturnStmt(std::shared_ptr<Return> stmt);
+	void visitReturnStmt(Return *stmt);
 
-	std::any visitExpressionStmt(std::shared_ptr<Expression> stmt);
+	void visitExpressionStmt(Expression *stmt);
 
-	std::any visitVarStmt(std::shared_ptr<Var> stmt);
+	void visitVarStmt(Var *stmt);
 
-	std::any visitWhileStmt(std::shared_ptr<While> stmt);
+	void visitWhileStmt(While *stmt);
 
-	void resolve(const std::vector<std::shared_ptr<Stmt>> &statements);
+	void resolve(const std::vector<Stmt *> &statements);
 
 private:
-	Interpreter &interpreter;
-	std::vector<std::map<std::wstring, bool>> scopes;
+	std::vector<Scope> scopes;
 	FunctionType currentFunction = FunctionType::NONE;
 	static ClassType currentClass;
 
-	void resolve(std::shared_ptr<Stmt> statement);
+	/*
+	 * Whether the locals of the current function are on the value
+	 * stack, the next free slot of its frame and the number of slots
+	 * used so far.
+	 */
+	bool inFrame = false;
+	int frameSlot = 0;
+	int frameSize = 0;
+
+	void resolve(Stmt *statement);
 
-	void resolve(std::shared_ptr<Expr> expr);
+	void resolve(Expr *expr);
 
 	void beginScope();
 
 	void endScope();
 
-	void declare(std::shared_ptr<Token> name);
+	void declare(const Token &name);
+
+	void define(const Token &name);
+
+	void defineName(std::string_view name);
+
+	/*
+	 * The slot for the next variable declared in the current scope.
+	 */
+	int nextSlot();
+
+	/*
+	 * Set depth and slot to the location of the variable name, or
+	 * leave them unchanged if the variable is global.
+	 */
+	void resolveLocal(const Token &name, int &depth, int &slot);
+
+	void resolveFunction(Function *func, FunctionType type);
 
-	void define(std::shared_ptr<Token> name);
+	/*
+	 * The number of variables declared directly in a block.
+	 */
+	static int countDeclarations(const std::vector<Stmt *> &statements);
 
-	void resolveLocal(std::shared_ptr<Expr> expr, std::shared_ptr<Token> name);
+	/*
+	 * Whether a function or class is declared in a statement, at any
+	 * depth, so that a closure may capture the variables around it.
+	 */
+	static bool declaresFunction(Stmt *stmt);
 
-	void resolveFunction(std::shared_ptr<Function> func, FunctionType type);
+	static bool declaresFunction(const std::vector<Stmt *> &statements);
 };
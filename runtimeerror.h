@@ -2,18 +2,26 @@
 
 #include <stdexcept>
 #include <string>
-#include <memory>
 
 #include "token.h"
 
 class RuntimeError : public std::runtime_error
 {
 public:
-	RuntimeError(std::shared_ptr<Token> _token, const std::wstring &message) :
+	RuntimeError(const Token &_token, const std::wstring &message) :
 		std::runtime_error(std::string(message.begin(), message.end())),
-		token(_token)
+		line(_token.line)
 	{
 	};
 
-	std::shared_ptr<Token> token;
+	/*
+	 * Error in the bytecode virtual machine, where only the line is known.
+	 */
+	RuntimeError(int _line, const std::wstring &message) :
+		std::runtime_error(std::string(message.begin(), message.end())),
+		line(_line)
+	{
+	};
+
+	int line;
 };
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+
+#include "scanner.h"
+#include "sourcefile.h"
+
+/*
+ * Micro-benchmark of the Scanner: scan a file a number of times and print
+ * the best rate, in tokens and megabytes per second.
+ */
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::wcerr << "Usage: " << argv[0] << " file [iterations]" << std::endl;
+		exit(64);
+	}
+
+	std::unique_ptr<SourceFile> source = SourceFile::map(argv[1]);
+	if (!source)
+	{
+		std::wcerr << "Cannot open " << argv[1] << std::endl;
+		exit(66);
+	}
+	int iterations = (argc > 2) ? atoi(argv[2]) : 10;
+
+	std::size_t tokens = 0;
+	double best = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Scanner scanner(source->bytes());
+		tokens = scanner.scanTokens().size();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (i == 0 || elapsed.count() < best)
+		{
+			best = elapsed.count();
+		}
+	}
+
+	double bytes = source->bytes().length();
+	std::wcout << tokens << " tokens, " << bytes / 1e6 << " MB, best of " <<
+		iterations << ": " << best * 1e3 << " ms, " <<
+		tokens / best / 1e6 << " M tokens/s, " <<
+		bytes / best / 1e6 << " MB/s" << std::endl;
+	return 0;
+}
@@ -1,42 +1,122 @@
+#include <algorithm>
+#include <charconv>
+
 #include "scanner.h"
 #include "lox.h"
+#include "stringtable.h"
+#include "utf8.h"
+
+/*
+ * The keyword type of the rest of an identifier after its first
+ * characters, or IDENTIFIER if it is not that keyword.
+ */
+static constexpr TokenType
+checkKeyword(std::string_view text, std::size_t begin, std::string_view rest,
+	TokenType type)
+{
+	if (text.length() == begin + rest.length() &&
+		text.substr(begin) == rest)
+	{
+		return type;
+	}
+	return IDENTIFIER;
+}
 
-const std::map<std::wstring, TokenType> Scanner::keywords =
+/*
+ * Recognize a keyword with a trie of switch statements on its first
+ * characters, as in Chapter 16 of the book, instead of looking the
+ * identifier up in a map.
+ */
+static constexpr TokenType
+keywordType(std::string_view text)
 {
-	{L"and", AND},
-	{L"class", CLASS},
-	{L"else", ELSE},
-	{L"false", FALSE},
-	{L"for", FOR},
-	{L"fun", FUN},
-	{L"if", IF},
-	{L"nil", NIL},
-	{L"or", OR},
-	{L"print", PRINT},
-	{L"return", RETURN},
-	{L"super", SUPER},
-	{L"this", THIS},
-	{L"true", TRUE},
-	{L"var", VAR},
-	{L"while", WHILE}
-};
-
-Scanner::Scanner(const std::wstring &bytes) :
-	source(bytes)
+	switch (text[0])
+	{
+		case 'a':
+			return checkKeyword(text, 1, "nd", AND);
+		case 'c':
+			return checkKeyword(text, 1, "lass", CLASS);
+		case 'e':
+			return checkKeyword(text, 1, "lse", ELSE);
+		case 'f':
+			if (text.length() > 1)
+			{
+				switch (text[1])
+				{
+					case 'a':
+						return checkKeyword(text, 2, "lse", FALSE);
+					case 'o':
+						return checkKeyword(text, 2, "r", FOR);
+					case 'u':
+						return checkKeyword(text, 2, "n", FUN);
+				}
+			}
+			break;
+		case 'i':
+			return checkKeyword(text, 1, "f", IF);
+		case 'n':
+			return checkKeyword(text, 1, "il", NIL);
+		case 'o':
+			return checkKeyword(text, 1, "r", OR);
+		case 'p':
+			return checkKeyword(text, 1, "rint", PRINT);
+		case 'r':
+			return checkKeyword(text, 1, "eturn", RETURN);
+		case 's':
+			return checkKeyword(text, 1, "uper", SUPER);
+		case 't':
+			if (text.length() > 1)
+			{
+				switch (text[1])
+				{
+					case 'h':
+						return checkKeyword(text, 2, "is", THIS);
+					case 'r':
+						return checkKeyword(text, 2, "ue", TRUE);
+				}
+			}
+			break;
+		case 'v':
+			return checkKeyword(text, 1, "ar", VAR);
+		case 'w':
+			return checkKeyword(text, 1, "hile", WHILE);
+	}
+	return IDENTIFIER;
+}
+
+static_assert(keywordType("and") == AND && keywordType("class") == CLASS &&
+	keywordType("else") == ELSE && keywordType("false") == FALSE &&
+	keywordType("for") == FOR && keywordType("fun") == FUN &&
+	keywordType("if") == IF && keywordType("nil") == NIL &&
+	keywordType("or") == OR && keywordType("print") == PRINT &&
+	keywordType("return") == RETURN && keywordType("super") == SUPER &&
+	keywordType("this") == THIS && keywordType("true") == TRUE &&
+	keywordType("var") == VAR && keywordType("while") == WHILE,
+	"Every keyword is recognized");
+
+static_assert(keywordType("f") == IDENTIFIER && keywordType("fo") == IDENTIFIER &&
+	keywordType("fork") == IDENTIFIER && keywordType("t") == IDENTIFIER &&
+	keywordType("thus") == IDENTIFIER && keywordType("v") == IDENTIFIER,
+	"Prefixes and extensions of keywords are identifiers");
+
+Scanner::Scanner(std::string_view bytes) :
+	source(bytes),
+	tokens(bytes)
 {
 }
 
-std::vector<std::shared_ptr<Token>>
+TokenBuffer
 Scanner::scanTokens()
 {
+	// Roughly one token for every few bytes of source.
+	tokens.reserve(source.length() / 4 + 1);
 	while (!isAtEnd())
 	{
 		start = current;
 		scanToken();
 	}
-	tokens.push_back(std::make_shared<Token>(END_OF_FILE, std::wstring(),
-		std::wstring(), line));
-	return tokens;
+	tokens.add(END_OF_FILE, source.length(), 0, line);
+	return std::move(tokens);
 }
 
 bool
@@ -48,7 +128,7 @@ Scanner::isAtEnd() const
 void
 Scanner::scanToken()
 {
-	wchar_t c = advance();
+	char c = advance();
 	switch (c)
 	{
 		case '(':
@@ -129,7 +209,10 @@ Scanner::scanToken()
 			}
 			else
 			{
-				Lox::error(line, std::wstring(L"Unexpected character: ") + c);
+				// Report a multibyte character once, not once per byte.
+				current = std::min(start + utf8SequenceLength(c), source.length());
+				Lox::error(line, L"Unexpected character: " +
+					decodeUtf8(source.substr(start, current - start)));
 			}
 			break;
 	}
@@ -142,16 +225,20 @@ Scanner::identifier()
 	{
 		advance();
 	}
-	std::wstring text = source.substr(start, current - start);
-	auto it = keywords.find(text);
-	if (it == keywords.end())
-		addToken(IDENTIFIER);
+	std::string_view text = source.substr(start, current - start);
+	TokenType type = keywordType(text);
+	if (type == IDENTIFIER)
+	{
+		tokens.addString(IDENTIFIER, start, current - start, line, intern(text));
+	}
 	else
-		addToken(it->second);
+	{
+		addToken(type);
+	}
 }
 
 bool
-Scanner::isAlpha(wchar_t c)
+Scanner::isAlpha(char c)
 {
 	return ((c >= 'a' && c <= 'z') ||
 		(c >= 'A' && c <= 'Z') ||
@@ -159,13 +246,13 @@ Scanner::isAlpha(wchar_t c)
 }
 
 bool
-Scanner::isAlphaNumeric(wchar_t c)
+Scanner::isAlphaNumeric(char c)
 {
 	return isAlpha(c) || isDigit(c);
 }
 
 bool
-Scanner::isDigit(wchar_t c)
+Scanner::isDigit(char c)
 {
 	return (c >= '0' && c <= '9');
 }
@@ -190,18 +277,19 @@ Scanner::number()
 		}
 	}
 
-	auto count = current - start;
-	addToken(NUMBER, std::stod(source.substr(start, count)));
+	double value = 0;
+	std::from_chars(source.data() + start, source.data() + current, value);
+	addToken(NUMBER, value);
 }
 
-wchar_t
+char
 Scanner::peekNext()
 {
-	if (current + 1 > source.length())
+	if (current + 1 >= source.length())
 	{
 		return '\0';
 	}
-	return source.at(current + 1);
+	return source[current + 1];
 }
 
 void
@@ -219,6 +307,7 @@ Scanner::string()
 	if (isAtEnd())
 	{
 		Lox::error(line, L"Unterminated string.");
+		return;
 	}
 
 	// The closing ".
@@ -226,36 +315,36 @@ Scanner::string()
 
 	// Trim the surrounding quotes.
 	auto count = current - start;
-	std::wstring value = source.substr(start + 1, count - 2);
-	addToken(STRING, value);
+	tokens.addString(STRING, start, count, line,
+		intern(source.substr(start + 1, count - 2)));
 }
 
-wchar_t
+char
 Scanner::peek()
 {
 	if (isAtEnd())
 		return '\0';
 
-	return source.at(current);
+	return source[current];
 }
 
 bool
-Scanner::match(wchar_t expected)
+Scanner::match(char expected)
 {
 	if (isAtEnd())
 		return false;
 
-	if (source.at(current) != expected)
+	if (source[current] != expected)
 		return false;
 
 	current++;
 	return true;
 }
 
-wchar_t
+char
 Scanner::advance()
 {
-	wchar_t c = source.at(current);
+	char c = source[current];
 	current++;
 	return c;
 }
@@ -263,21 +352,25 @@ Scanner::advance()
 void
 Scanner::addToken(TokenType type)
 {
-	std::wstring text = source.substr(start, current - start);
-	tokens.push_back(std::make_shared<Token>(type, text, line));
+	tokens.add(type, start, current - start, line);
 }
 
 void
 Scanner::addToken(TokenType type, double literal)
 {
-	std::wstring text = source.substr(start, current- start);
-	tokens.push_back(std::make_shared<Token>(type, text, literal, line));
+	tokens.addNumber(type, start, current - start, line, literal);
 }
 
-void
-Scanner::addToken(TokenType type, const std::wstring &literal)
+std::uint32_t
+Scanner::intern(std::string_view bytes)
 {
-	std::wstring text = source.substr(start, current - start);
-	tokens.push_back(std::make_shared<Token>(type, text, literal, line));
+	auto it = interned.find(bytes);
+	if (it != interned.end())
+	{
+		return it->second;
+	}
+	std::uint32_t index = tokens.addInterned(StringTable::intern(decodeUtf8(bytes)));
+	interned.emplace(bytes, index);
+	return index;
 }
 
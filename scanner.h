@@ -1,39 +1,51 @@
 #pragma once
 
-#include <vector>
+#include <cstdint>
 #include <string>
-#include <map>
+#include <string_view>
 #include <memory>
+#include <unordered_map>
 
 #include "token.h"
+#include "tokenbuffer.h"
 
+/**
+ * Scanner of UTF-8 source code. Tokens refer to their lexemes in the
+ * source rather than copying them, so the source must be kept as long
+ * as the tokens.
+ */
 class Scanner
 {
 public:
-	Scanner(const std::wstring &bytes);
+	Scanner(std::string_view bytes);
 
-	std::vector<std::shared_ptr<Token>> scanTokens();
+	TokenBuffer scanTokens();
 private:
 	bool isAtEnd() const;
 	void scanToken();
 	void identifier();
-	bool isAlpha(wchar_t c);
-	bool isAlphaNumeric(wchar_t c);
-	bool isDigit(wchar_t c);
+	bool isAlpha(char c);
+	bool isAlphaNumeric(char c);
+	bool isDigit(char c);
 	void number();
-	wchar_t peekNext();
+	char peekNext();
 	void string();
-	wchar_t peek();
-	bool match(wchar_t expected);
-	wchar_t advance();
+	char peek();
+	bool match(char expected);
+	char advance();
 	void addToken(TokenType type);
 	void addToken(TokenType type, double literal);
-	void addToken(TokenType type, const std::wstring &literal);
+	std::uint32_t intern(std::string_view bytes);
 
-	std::wstring source;
-	std::vector<std::shared_ptr<Token>> tokens;
-	std::wstring::size_type start = 0;
-	std::wstring::size_type current = 0;
+	std::string_view source;
+	TokenBuffer tokens;
+	std::size_t start = 0;
+	std::size_t current = 0;
 	int line = 1;
-	static const std::map<std::wstring, TokenType> keywords;
+
+	/*
+	 * Indexes of the identifiers and strings interned so far in the
+	 * string table of tokens, so that each is decoded only once.
+	 */
+	std::unordered_map<std::string_view, std::uint32_t> interned;
 };
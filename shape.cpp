@@ -0,0 +1,28 @@
+#include "shape.h"
+
+int
+Shape::lookup(const std::shared_ptr<LoxString> &name) const
+{
+	auto it = slots.find(name);
+	if (it != slots.end())
+	{
+		return it->second;
+	}
+	return -1;
+}
+
+std::shared_ptr<Shape>
+Shape::addField(const std::shared_ptr<LoxString> &name)
+{
+	auto it = transitions.find(name);
+	if (it != transitions.end())
+	{
+		return it->second;
+	}
+
+	std::shared_ptr<Shape> shape = std::make_shared<Shape>();
+	shape->slots = slots;
+	shape->slots.insert_or_assign(name, static_cast<int>(slots.size()));
+	transitions.insert_or_assign(name, shape);
+	return shape;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "loxstring.h"
+
+/**
+ * A hidden class, describing the layout of the fields of a LoxInstance.
+ * Instances with the same fields, added in the same order, share a Shape,
+ * so a field can be found by comparing Shape pointers and its value
+ * loaded from a flat array.
+ *
+ * Each LoxClass has an empty root Shape, so a Shape also identifies the
+ * class of the instances that have it. Shapes are never modified after
+ * fields are added, adding a field moves an instance to another Shape.
+ */
+class Shape
+{
+public:
+	/*
+	 * Index of field name in the instance fields, or -1 if there is
+	 * no such field.
+	 */
+	int lookup(const std::shared_ptr<LoxString> &name) const;
+
+	/*
+	 * The Shape with all fields of this Shape, followed by name.
+	 */
+	std::shared_ptr<Shape> addField(const std::shared_ptr<LoxString> &name);
+
+private:
+	std::unordered_map<std::shared_ptr<LoxString>, int> slots;
+
+	std::unordered_map<std::shared_ptr<LoxString>, std::shared_ptr<Shape>> transitions;
+};
@@ -0,0 +1,73 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sourcefile.h"
+
+std::unique_ptr<SourceFile>
+SourceFile::map(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return std::unique_ptr<SourceFile>();
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return std::unique_ptr<SourceFile>();
+	}
+
+	std::unique_ptr<SourceFile> source(new SourceFile());
+	if (!S_ISREG(st.st_mode))
+	{
+		// Pipes and devices cannot be mapped, so read them instead.
+		char buf[4096];
+		ssize_t count;
+		while ((count = read(fd, buf, sizeof(buf))) > 0)
+		{
+			source->text.append(buf, count);
+		}
+	}
+	else if (st.st_size > 0)
+	{
+		void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close(fd);
+			return std::unique_ptr<SourceFile>();
+		}
+		// The scanner reads the file once from start to end.
+		madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+		source->mapping = mapping;
+		source->length = st.st_size;
+	}
+	close(fd);
+	return source;
+}
+
+SourceFile::SourceFile(std::string _text) :
+	text(std::move(_text))
+{
+}
+
+SourceFile::~SourceFile()
+{
+	if (mapping)
+	{
+		munmap(mapping, length);
+	}
+}
+
+std::string_view
+SourceFile::bytes() const
+{
+	if (mapping)
+	{
+		return std::string_view(static_cast<const char *>(mapping), length);
+	}
+	return text;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * UTF-8 source code of a script or of a line typed at the prompt.
+ *
+ * A script is memory-mapped rather than read, so it is not copied, and
+ * tokens refer to their lexemes in the mapping. The source must be kept
+ * as long as any token or syntax tree node scanned from it.
+ */
+class SourceFile
+{
+public:
+	/*
+	 * Map a file, or return nullptr if it cannot be opened.
+	 */
+	static std::unique_ptr<SourceFile> map(const char *path);
+
+	SourceFile(std::string _text);
+
+	SourceFile(const SourceFile &) = delete;
+
+	SourceFile &operator=(const SourceFile &) = delete;
+
+	~SourceFile();
+
+	std::string_view bytes() const;
+
+private:
+	SourceFile() = default;
+
+	/*
+	 * Source that was not mapped.
+	 */
+	std::string text;
+
+	void *mapping = nullptr;
+
+	std::size_t length = 0;
+};
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <mutex>
+
+#include "stringtable.h"
+
+/*
+ * Number of entries at which the table is next checked for expired
+ * strings.
+ */
+static std::size_t sweepThreshold = 1024;
+
+/*
+ * Sources are scanned concurrently, so the table is locked.
+ */
+static std::mutex tableMutex;
+
+std::shared_ptr<LoxString>
+StringTable::intern(const std::wstring &value)
+{
+	std::lock_guard<std::mutex> lock(tableMutex);
+	auto &table = strings();
+	auto it = table.find(value);
+	if (it != table.end())
+	{
+		std::shared_ptr<LoxString> str = it->second.lock();
+		if (str)
+		{
+			return str;
+		}
+	}
+
+	std::shared_ptr<LoxString> str = std::make_shared<LoxString>(value);
+	if (it != table.end())
+	{
+		it->second = str;
+		return str;
+	}
+
+	if (table.size() >= sweepThreshold)
+	{
+		removeExpired();
+		sweepThreshold = std::max(sweepThreshold, table.size() * 2);
+	}
+	table.emplace(value, str);
+	return str;
+}
+
+std::unordered_map<std::wstring, std::weak_ptr<LoxString>> &
+StringTable::strings()
+{
+	// Constructed on first use, so that strings can be interned during
+	// static initialization.
+	static std::unordered_map<std::wstring, std::weak_ptr<LoxString>> table;
+	return table;
+}
+
+void
+StringTable::removeExpired()
+{
+	auto &table = strings();
+	for (auto it = table.begin(); it != table.end(); )
+	{
+		if (it->second.expired())
+		{
+			it = table.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "loxstring.h"
+
+/**
+ * Table of interned strings. All LoxString objects are created through
+ * intern(), so there is only one LoxString for each string value and
+ * strings and identifiers can be compared by pointer.
+ *
+ * The table holds weak references, so that strings that are no longer
+ * used are freed. Expired entries are removed when the table grows.
+ * Strings may be interned from several threads.
+ */
+class StringTable
+{
+public:
+	static std::shared_ptr<LoxString> intern(const std::wstring &value);
+
+private:
+	static std::unordered_map<std::wstring, std::weak_ptr<LoxString>> &strings();
+
+	static void removeExpired();
+};
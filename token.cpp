@@ -1,34 +1,33 @@
 #include "token.h"
+#include "utf8.h"
 
-Token::Token(TokenType _type, const std::wstring &_lexeme, int _line) :
+Token::Token(TokenType _type, std::string_view _lexeme, int _line) :
 	type(_type),
 	lexeme(_lexeme),
 	line(_line)
 {
 }
 
-Token::Token(TokenType _type, const std::wstring &_lexeme, const std::wstring &_literal, int _line) :
+Token::Token(TokenType _type, std::string_view _lexeme, double _literal, int _line) :
 	type(_type),
 	lexeme(_lexeme),
-	string_literal(_literal),
+	double_literal(_literal),
 	line(_line)
 {
 }
 
-Token::Token(TokenType _type, const std::wstring &_lexeme, double _literal, int _line) :
-	type(_type),
-	lexeme(_lexeme),
-	double_literal(_literal),
-	line(_line)
+std::wstring
+Token::text() const
 {
+	return decodeUtf8(lexeme);
 }
 
 std::wostream& operator<< (std::wostream& stream, const Token& token)
 {
-	stream << token.type << " " << token.lexeme << " ";
+	stream << token.type << " " << token.text() << " ";
        	if (token.type == NUMBER)
 		stream << token.double_literal;
-	else
-		stream << token.string_literal;
+	else if (token.type == STRING)
+		stream << token.interned->value;
 	return stream;
 }
@@ -1,24 +1,41 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
 
 #include "tokentype.h"
+#include "loxstring.h"
 
 class Token
 {
 public:
 	TokenType type = END_OF_FILE;
-	std::wstring lexeme;
 
-	std::wstring string_literal;
+	/*
+	 * The UTF-8 lexeme, a view into the source the token was scanned
+	 * from, which must be kept as long as the token.
+	 */
+	std::string_view lexeme;
+
 	double double_literal = 0;
 	int line = 0;
 
-	Token(TokenType _type, const std::wstring &_lexeme, int _line);
+	/*
+	 * The interned name of an identifier, or the interned value of a
+	 * string literal.
+	 */
+	std::shared_ptr<LoxString> interned;
+
+	Token(TokenType _type, std::string_view _lexeme, int _line);
 
-	Token(TokenType _type, const std::wstring &_lexeme, const std::wstring &_literal, int _line);
+	Token(TokenType _type, std::string_view _lexeme, double _literal, int _line);
 
-	Token(TokenType _type, const std::wstring &_lexeme, double _literal, int _line);
+	/*
+	 * The lexeme as a wide string, for messages.
+	 */
+	std::wstring text() const;
 
 	friend std::wostream& operator<< (std::wostream& out, const Token &token);
 };
@@ -0,0 +1,68 @@
+#include "tokenbuffer.h"
+
+TokenBuffer::TokenBuffer(std::string_view _source) :
+	source(_source)
+{
+}
+
+void
+TokenBuffer::reserve(std::size_t count)
+{
+	types.reserve(count);
+	starts.reserve(count);
+	lengths.reserve(count);
+	lines.reserve(count);
+	literals.reserve(count);
+}
+
+void
+TokenBuffer::add(TokenType type, std::size_t start, std::size_t length, int line)
+{
+	types.push_back(type);
+	starts.push_back(start);
+	lengths.push_back(length);
+	lines.push_back(line);
+	literals.push_back(0);
+}
+
+void
+TokenBuffer::addNumber(TokenType type, std::size_t start, std::size_t length,
+	int line, double literal)
+{
+	add(type, start, length, line);
+	literals.back() = numbers.size();
+	numbers.push_back(literal);
+}
+
+void
+TokenBuffer::addString(TokenType type, std::size_t start, std::size_t length,
+	int line, std::uint32_t stringIndex)
+{
+	add(type, start, length, line);
+	literals.back() = stringIndex;
+}
+
+std::uint32_t
+TokenBuffer::addInterned(std::shared_ptr<LoxString> str)
+{
+	strings.push_back(std::move(str));
+	return strings.size() - 1;
+}
+
+Token
+TokenBuffer::token(std::size_t index) const
+{
+	TokenType tokenType = types[index];
+	if (tokenType == NUMBER)
+	{
+		return Token(tokenType, lexeme(index), numbers[literals[index]],
+			lines[index]);
+	}
+
+	Token t(tokenType, lexeme(index), lines[index]);
+	if (tokenType == IDENTIFIER || tokenType == STRING)
+	{
+		t.interned = strings[literals[index]];
+	}
+	return t;
+}
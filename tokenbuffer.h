@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "token.h"
+
+/**
+ * The tokens of one source, stored as parallel arrays rather than as
+ * Token objects, so that the parser looks ahead through a dense array
+ * of token types.
+ *
+ * Lexemes are stored as offsets into the source, which must be kept as
+ * long as the buffer. Number literals and interned names and strings are
+ * kept in separate tables, and a token holds the index of its literal.
+ */
+class TokenBuffer
+{
+public:
+	TokenBuffer(std::string_view _source);
+
+	void reserve(std::size_t count);
+
+	void add(TokenType type, std::size_t start, std::size_t length, int line);
+
+	void addNumber(TokenType type, std::size_t start, std::size_t length, int line,
+		double literal);
+
+	void addString(TokenType type, std::size_t start, std::size_t length, int line,
+		std::uint32_t stringIndex);
+
+	/*
+	 * Add an interned identifier or string to the string table, returning
+	 * its index.
+	 */
+	std::uint32_t addInterned(std::shared_ptr<LoxString> str);
+
+	std::size_t size() const
+	{
+		return types.size();
+	}
+
+	TokenType type(std::size_t index) const
+	{
+		return types[index];
+	}
+
+	int line(std::size_t index) const
+	{
+		return lines[index];
+	}
+
+	std::string_view lexeme(std::size_t index) const
+	{
+		return source.substr(starts[index], lengths[index]);
+	}
+
+	/*
+	 * Create the Token at an index, for the syntax tree or a message.
+	 */
+	Token token(std::size_t index) const;
+
+private:
+	std::string_view source;
+
+	std::vector<TokenType> types;
+
+	std::vector<std::uint32_t> starts;
+
+	std::vector<std::uint32_t> lengths;
+
+	std::vector<int> lines;
+
+	/*
+	 * Index in numbers for NUMBER tokens, in strings for IDENTIFIER and
+	 * STRING tokens.
+	 */
+	std::vector<std::uint32_t> literals;
+
+	std::vector<double> numbers;
+
+	std::vector<std::shared_ptr<LoxString>> strings;
+};
@@ -0,0 +1,109 @@
+#include "utf8.h"
+
+static const wchar_t REPLACEMENT_CHARACTER = 0xfffd;
+
+std::size_t
+utf8SequenceLength(unsigned char c)
+{
+	if (c < 0x80)
+	{
+		return 1;
+	}
+	if ((c & 0xe0) == 0xc0)
+	{
+		return 2;
+	}
+	if ((c & 0xf0) == 0xe0)
+	{
+		return 3;
+	}
+	if ((c & 0xf8) == 0xf0)
+	{
+		return 4;
+	}
+	return 1;
+}
+
+std::wstring
+decodeUtf8(std::string_view bytes)
+{
+	std::wstring text;
+	text.reserve(bytes.size());
+	std::size_t i = 0;
+	while (i < bytes.size())
+	{
+		unsigned char c = bytes[i];
+		if (c < 0x80)
+		{
+			text.push_back(c);
+			i++;
+			continue;
+		}
+
+		std::size_t length = utf8SequenceLength(c);
+		if (length == 1 || i + length > bytes.size())
+		{
+			text.push_back(REPLACEMENT_CHARACTER);
+			i++;
+			continue;
+		}
+
+		char32_t codePoint = c & (0x7f >> length);
+		bool valid = true;
+		for (std::size_t j = 1; j < length; j++)
+		{
+			unsigned char next = bytes[i + j];
+			if ((next & 0xc0) != 0x80)
+			{
+				valid = false;
+				break;
+			}
+			codePoint = (codePoint << 6) | (next & 0x3f);
+		}
+		if (valid)
+		{
+			text.push_back(static_cast<wchar_t>(codePoint));
+			i += length;
+		}
+		else
+		{
+			text.push_back(REPLACEMENT_CHARACTER);
+			i++;
+		}
+	}
+	return text;
+}
+
+std::string
+encodeUtf8(const std::wstring &text)
+{
+	std::string bytes;
+	bytes.reserve(text.size());
+	for (wchar_t wc : text)
+	{
+		char32_t c = static_cast<char32_t>(wc);
+		if (c < 0x80)
+		{
+			bytes.push_back(static_cast<char>(c));
+		}
+		else if (c < 0x800)
+		{
+			bytes.push_back(static_cast<char>(0xc0 | (c >> 6)));
+			bytes.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+		}
+		else if (c < 0x10000)
+		{
+			bytes.push_back(static_cast<char>(0xe0 | (c >> 12)));
+			bytes.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+			bytes.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+		}
+		else
+		{
+			bytes.push_back(static_cast<char>(0xf0 | (c >> 18)));
+			bytes.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+			bytes.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+			bytes.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+		}
+	}
+	return bytes;
+}
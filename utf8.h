@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/*
+ * Conversion between the UTF-8 encoding of source files and the wide
+ * strings used for values and messages.
+ */
+
+/*
+ * Decode UTF-8 bytes. Invalid sequences are decoded as U+FFFD.
+ */
+std::wstring decodeUtf8(std::string_view bytes);
+
+std::string encodeUtf8(const std::wstring &text);
+
+/*
+ * Length of the UTF-8 sequence starting with the given byte.
+ */
+std::size_t utf8SequenceLength(unsigned char c);
@@ -0,0 +1,48 @@
+#include <sstream>
+
+#include "value.h"
+
+bool
+Value::equals(const Value &other) const
+{
+	if (type != other.type)
+	{
+		return false;
+	}
+
+	switch (type)
+	{
+		case ValueType::NIL:
+			return true;
+		case ValueType::BOOLEAN:
+			return boolean == other.boolean;
+		case ValueType::NUMBER:
+			return number == other.number;
+		case ValueType::OBJECT:
+			// Strings are interned, so equal strings are the same object.
+			return object == other.object;
+	}
+	return false;
+}
+
+std::wstring
+Value::toString() const
+{
+	switch (type)
+	{
+		case ValueType::NIL:
+			return std::wstring(L"nil");
+		case ValueType::BOOLEAN:
+			return boolean ? std::wstring(L"true") : std::wstring(L"false");
+		case ValueType::NUMBER:
+		{
+			std::wostringstream os;
+			os.precision(15);
+			os << number;
+			return os.str();
+		}
+		case ValueType::OBJECT:
+			return object->toString();
+	}
+	return std::wstring(L"");
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "loxobject.h"
+
+enum class ValueType
+{
+	NIL,
+	BOOLEAN,
+	NUMBER,
+	OBJECT
+};
+
+/**
+ * A runtime value. Replaces the java.lang.Object used in the book.
+ *
+ * Nil, booleans and numbers are held unboxed in the value itself, so that
+ * arithmetic does not allocate. Strings, functions, classes and instances
+ * are held by pointer to a LoxObject, tagged with its ObjectType.
+ */
+class Value
+{
+public:
+	Value() :
+		type(ValueType::NIL),
+		number(0)
+	{
+	}
+
+	explicit Value(bool b) :
+		type(ValueType::BOOLEAN),
+		boolean(b)
+	{
+	}
+
+	explicit Value(double d) :
+		type(ValueType::NUMBER),
+		number(d)
+	{
+	}
+
+	explicit Value(std::shared_ptr<LoxObject> obj) :
+		type(ValueType::OBJECT),
+		number(0),
+		object(std::move(obj))
+	{
+	}
+
+	bool isNil() const
+	{
+		return type == ValueType::NIL;
+	}
+
+	bool isBoolean() const
+	{
+		return type == ValueType::BOOLEAN;
+	}
+
+	bool isNumber() const
+	{
+		return type == ValueType::NUMBER;
+	}
+
+	bool isObject() const
+	{
+		return type == ValueType::OBJECT;
+	}
+
+	bool isObjectType(ObjectType objectType) const
+	{
+		return type == ValueType::OBJECT && object->objectType == objectType;
+	}
+
+	bool isString() const
+	{
+		return isObjectType(ObjectType::STRING);
+	}
+
+	bool isCallable() const
+	{
+		return isObjectType(ObjectType::FUNCTION) ||
+			isObjectType(ObjectType::NATIVE) ||
+			isObjectType(ObjectType::CLASS);
+	}
+
+	bool asBoolean() const
+	{
+		return boolean;
+	}
+
+	double asNumber() const
+	{
+		return number;
+	}
+
+	const std::shared_ptr<LoxObject> &asObject() const
+	{
+		return object;
+	}
+
+	/*
+	 * Downcast the object, the caller must have checked the ObjectType.
+	 */
+	template <class T>
+	std::shared_ptr<T> as() const
+	{
+		return std::static_pointer_cast<T>(object);
+	}
+
+	bool isTruthy() const
+	{
+		if (type == ValueType::NIL)
+		{
+			return false;
+		}
+		if (type == ValueType::BOOLEAN)
+		{
+			return boolean;
+		}
+		return true;
+	}
+
+	/*
+	 * Add the object held by this value to references, for the Heap.
+	 */
+	void traceReference(std::vector<HeapObject *> &references) const
+	{
+		if (type == ValueType::OBJECT)
+		{
+			references.push_back(object.get());
+		}
+	}
+
+	bool equals(const Value &other) const;
+
+	std::wstring toString() const;
+
+private:
+	ValueType type;
+
+	union
+	{
+		bool boolean;
+		double number;
+	};
+
+	std::shared_ptr<LoxObject> object;
+};
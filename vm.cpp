@@ -0,0 +1,623 @@
+#include <sstream>
+
+#include "vm.h"
+#include "compiler.h"
+#include "clockfunction.h"
+#include "runtimeerror.h"
+#include "lox.h"
+#include "stringtable.h"
+
+VM::VM() :
+	stack(STACK_MAX),
+	frames(FRAMES_MAX)
+{
+	stackTop = stack.data();
+	initString = identifier(L"init");
+
+	defineNative(L"clock", std::make_shared<ClockFunction>());
+	defineNative(L"nanotime", std::make_shared<NanoTimeFunction>());
+	defineNative(L"cpuTime", std::make_shared<CpuTimeFunction>());
+}
+
+void
+VM::interpret(const std::vector<Stmt *> &statements)
+{
+	Compiler compiler(*this);
+	std::shared_ptr<VmFunction> function = compiler.compile(statements);
+	if (!function)
+	{
+		return;
+	}
+
+	try
+	{
+		std::shared_ptr<VmClosure> closure = Heap::allocate<VmClosure>(function);
+		push(Value(closure));
+		call(closure.get(), 0);
+		run();
+	}
+	catch (const RuntimeError &e)
+	{
+		Lox::runtimeError(e);
+		resetStack();
+	}
+}
+
+std::shared_ptr<LoxString>
+VM::identifier(const std::wstring &name)
+{
+	std::shared_ptr<LoxString> str = StringTable::intern(name);
+	identifiers.insert(str);
+	return str;
+}
+
+std::size_t
+VM::globalIndex(const std::wstring &name)
+{
+	auto it = globalIndices.find(name);
+	if (it != globalIndices.end())
+	{
+		return it->second;
+	}
+
+	GlobalVariable global;
+	global.name = identifier(name);
+	globals.push_back(global);
+	globalIndices.insert_or_assign(name, globals.size() - 1);
+	return globals.size() - 1;
+}
+
+void
+VM::run()
+{
+	CallFrame *frame = &frames[frameCount - 1];
+
+#define READ_BYTE() (*frame->ip++)
+#define READ_SHORT() \
+	(frame->ip += 2, static_cast<uint16_t>((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_CONSTANT() (frame->closure->function->chunk.constants[READ_SHORT()])
+#define READ_STRING() (READ_CONSTANT().asObject().get())
+#define BINARY_OP(op) \
+	do \
+	{ \
+		if (!stackTop[-1].isNumber() || !stackTop[-2].isNumber()) \
+		{ \
+			runtimeError(L"Operands must be numbers."); \
+		} \
+		double b = stackTop[-1].asNumber(); \
+		double a = stackTop[-2].asNumber(); \
+		stackTop--; \
+		stackTop[-1] = Value(a op b); \
+	} \
+	while (false)
+
+	while (true)
+	{
+		uint8_t instruction = READ_BYTE();
+		switch (instruction)
+		{
+			case OP_CONSTANT:
+				push(READ_CONSTANT());
+				break;
+			case OP_NIL:
+				push(Value());
+				break;
+			case OP_TRUE:
+				push(Value(true));
+				break;
+			case OP_FALSE:
+				push(Value(false));
+				break;
+			case OP_POP:
+				pop();
+				break;
+			case OP_GET_LOCAL:
+				push(frame->slots[READ_BYTE()]);
+				break;
+			case OP_SET_LOCAL:
+				frame->slots[READ_BYTE()] = peek(0);
+				break;
+			case OP_GET_GLOBAL:
+			{
+				GlobalVariable &global = globals[READ_SHORT()];
+				if (!global.defined)
+				{
+					runtimeError(L"Undefined variable '" + global.name->value + L"'.");
+				}
+				push(global.value);
+				break;
+			}
+			case OP_DEFINE_GLOBAL:
+			{
+				GlobalVariable &global = globals[READ_SHORT()];
+				global.value = pop();
+				global.defined = true;
+				break;
+			}
+			case OP_SET_GLOBAL:
+			{
+				GlobalVariable &global = globals[READ_SHORT()];
+				if (!global.defined)
+				{
+					runtimeError(L"Undefined variable '" + global.name->value + L"'.");
+				}
+				global.value = peek(0);
+				break;
+			}
+			case OP_GET_UPVALUE:
+				push(*frame->closure->upvalues[READ_BYTE()]->location);
+				break;
+			case OP_SET_UPVALUE:
+				*frame->closure->upvalues[READ_BYTE()]->location = peek(0);
+				break;
+			case OP_GET_PROPERTY:
+			{
+				if (!peek(0).isObjectType(ObjectType::VM_INSTANCE))
+				{
+					runtimeError(L"Only instances have properties.");
+				}
+
+				VmInstance *instance = static_cast<VmInstance *>(peek(0).asObject().get());
+				const LoxString *name = static_cast<const LoxString *>(READ_STRING());
+				auto it = instance->fields.find(name);
+				if (it != instance->fields.end())
+				{
+					stackTop[-1] = it->second;
+					break;
+				}
+
+				bindMethod(instance->klass.get(), name);
+				break;
+			}
+			case OP_SET_PROPERTY:
+			{
+				if (!peek(1).isObjectType(ObjectType::VM_INSTANCE))
+				{
+					runtimeError(L"Only instances have fields.");
+				}
+
+				VmInstance *instance = static_cast<VmInstance *>(peek(1).asObject().get());
+				const LoxString *name = static_cast<const LoxString *>(READ_STRING());
+				instance->fields.insert_or_assign(name, peek(0));
+				Value value = pop();
+				stackTop[-1] = value;
+				break;
+			}
+			case OP_GET_SUPER:
+			{
+				const LoxString *name = static_cast<const LoxString *>(READ_STRING());
+				Value superclass = pop();
+				bindMethod(static_cast<VmClass *>(superclass.asObject().get()), name);
+				break;
+			}
+			case OP_EQUAL:
+			{
+				Value b = pop();
+				stackTop[-1] = Value(stackTop[-1].equals(b));
+				break;
+			}
+			case OP_NOT_EQUAL:
+			{
+				Value b = pop();
+				stackTop[-1] = Value(!stackTop[-1].equals(b));
+				break;
+			}
+			case OP_GREATER:
+				BINARY_OP(>);
+				break;
+			case OP_GREATER_EQUAL:
+				BINARY_OP(>=);
+				break;
+			case OP_LESS:
+				BINARY_OP(<);
+				break;
+			case OP_LESS_EQUAL:
+				BINARY_OP(<=);
+				break;
+			case OP_ADD:
+			{
+				if (stackTop[-1].isNumber() && stackTop[-2].isNumber())
+				{
+					double b = stackTop[-1].asNumber();
+					double a = stackTop[-2].asNumber();
+					stackTop--;
+					stackTop[-1] = Value(a + b);
+				}
+				else if (stackTop[-1].isString() && stackTop[-2].isString())
+				{
+					Value b = pop();
+					std::shared_ptr<LoxString> a = stackTop[-1].as<LoxString>();
+					stackTop[-1] = Value(StringTable::intern(a->value +
+						b.as<LoxString>()->value));
+				}
+				else
+				{
+					runtimeError(L"Operands must be two numbers or two strings.");
+				}
+				break;
+			}
+			case OP_SUBTRACT:
+				BINARY_OP(-);
+				break;
+			case OP_MULTIPLY:
+				BINARY_OP(*);
+				break;
+			case OP_DIVIDE:
+				BINARY_OP(/);
+				break;
+			case OP_NOT:
+				stackTop[-1] = Value(!stackTop[-1].isTruthy());
+				break;
+			case OP_NEGATE:
+				if (!peek(0).isNumber())
+				{
+					runtimeError(L"Operand must be a number.");
+				}
+				stackTop[-1] = Value(-stackTop[-1].asNumber());
+				break;
+			case OP_PRINT:
+				std::wcout << pop().toString() << std::endl;
+				break;
+			case OP_JUMP:
+			{
+				uint16_t offset = READ_SHORT();
+				frame->ip += offset;
+				break;
+			}
+			case OP_JUMP_IF_FALSE:
+			{
+				uint16_t offset = READ_SHORT();
+				if (!peek(0).isTruthy())
+				{
+					frame->ip += offset;
+				}
+				break;
+			}
+			case OP_LOOP:
+			{
+				uint16_t offset = READ_SHORT();
+				frame->ip -= offset;
+				break;
+			}
+			case OP_CALL:
+			{
+				int argCount = READ_BYTE();
+				callValue(peek(argCount), argCount);
+				frame = &frames[frameCount - 1];
+				break;
+			}
+			case OP_INVOKE:
+			{
+				const LoxString *method = static_cast<const LoxString *>(READ_STRING());
+				int argCount = READ_BYTE();
+				invoke(method, argCount);
+				frame = &frames[frameCount - 1];
+				break;
+			}
+			case OP_SUPER_INVOKE:
+			{
+				const LoxString *method = static_cast<const LoxString *>(READ_STRING());
+				int argCount = READ_BYTE();
+				Value superclass = pop();
+				invokeFromClass(static_cast<VmClass *>(superclass.asObject().get()),
+					method, argCount);
+				frame = &frames[frameCount - 1];
+				break;
+			}
+			case OP_CLOSURE:
+			{
+				std::shared_ptr<VmFunction> function = READ_CONSTANT().as<VmFunction>();
+				std::shared_ptr<VmClosure> closure = Heap::allocate<VmClosure>(function);
+				push(Value(closure));
+				for (std::size_t i = 0; i < closure->upvalues.size(); i++)
+				{
+					uint8_t isLocal = READ_BYTE();
+					uint8_t index = READ_BYTE();
+					if (isLocal)
+					{
+						closure->upvalues[i] = captureUpvalue(frame->slots + index);
+					}
+					else
+					{
+						closure->upvalues[i] = frame->closure->upvalues[index];
+					}
+				}
+				break;
+			}
+			case OP_CLOSE_UPVALUE:
+				closeUpvalues(stackTop - 1);
+				pop();
+				break;
+			case OP_RETURN:
+			{
+				Value result = pop();
+				closeUpvalues(frame->slots);
+				frameCount--;
+
+				// Release the arguments and locals of the function.
+				while (stackTop > frame->slots)
+				{
+					pop();
+				}
+
+				if (frameCount == 0)
+				{
+					return;
+				}
+
+				push(result);
+				frame = &frames[frameCount - 1];
+				break;
+			}
+			case OP_CLASS:
+			{
+				std::shared_ptr<LoxString> name = READ_CONSTANT().as<LoxString>();
+				push(Value(Heap::allocate<VmClass>(name)));
+				break;
+			}
+			case OP_INHERIT:
+			{
+				if (!peek(1).isObjectType(ObjectType::VM_CLASS))
+				{
+					runtimeError(L"Superclass must be a class.");
+				}
+
+				VmClass *superclass = static_cast<VmClass *>(peek(1).asObject().get());
+				VmClass *subclass = static_cast<VmClass *>(peek(0).asObject().get());
+				subclass->methods = superclass->methods;
+				pop();
+				break;
+			}
+			case OP_METHOD:
+				defineMethod(static_cast<const LoxString *>(READ_STRING()));
+				break;
+		}
+	}
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef BINARY_OP
+}
+
+void
+VM::push(const Value &value)
+{
+	*stackTop = value;
+	stackTop++;
+}
+
+Value
+VM::pop()
+{
+	stackTop--;
+	return std::move(*stackTop);
+}
+
+const Value &
+VM::peek(int distance)
+{
+	return stackTop[-1 - distance];
+}
+
+void
+VM::call(VmClosure *closure, int argCount)
+{
+	if (argCount != closure->function->arity)
+	{
+		std::wostringstream os;
+		os << L"Expected " << closure->function->arity << L" arguments but got " <<
+			argCount << L".";
+		runtimeError(os.str());
+	}
+
+	if (frameCount == FRAMES_MAX)
+	{
+		runtimeError(L"Stack overflow.");
+	}
+
+	CallFrame *frame = &frames[frameCount++];
+	frame->closure = closure;
+	frame->ip = closure->function->chunk.code.data();
+	frame->slots = stackTop - argCount - 1;
+}
+
+void
+VM::callValue(const Value &callee, int argCount)
+{
+	if (callee.isObject())
+	{
+		switch (callee.asObject()->objectType)
+		{
+			case ObjectType::VM_BOUND_METHOD:
+			{
+				// The receiver replaces the bound method in the stack
+				// slot, the method stays alive through the class.
+				VmBoundMethod *bound = static_cast<VmBoundMethod *>(callee.asObject().get());
+				VmClosure *method = bound->method.get();
+				stackTop[-argCount - 1] = Value(bound->receiver);
+				call(method, argCount);
+				return;
+			}
+			case ObjectType::VM_CLASS:
+			{
+				std::shared_ptr<VmClass> klass = callee.as<VmClass>();
+				stackTop[-argCount - 1] = Value(Heap::allocate<VmInstance>(klass));
+
+				auto it = klass->methods.find(initString.get());
+				if (it != klass->methods.end())
+				{
+					call(static_cast<VmClosure *>(it->second.asObject().get()), argCount);
+				}
+				else if (argCount != 0)
+				{
+					std::wostringstream os;
+					os << L"Expected 0 arguments but got " << argCount << L".";
+					runtimeError(os.str());
+				}
+				return;
+			}
+			case ObjectType::VM_CLOSURE:
+				call(static_cast<VmClosure *>(callee.asObject().get()), argCount);
+				return;
+			case ObjectType::NATIVE:
+			{
+				std::shared_ptr<LoxCallable> native = callee.as<LoxCallable>();
+				if (static_cast<std::size_t>(argCount) != native->arity())
+				{
+					std::wostringstream os;
+					os << L"Expected " << native->arity() << L" arguments but got " <<
+						argCount << L".";
+					runtimeError(os.str());
+				}
+
+				// Natives do not use the tree-walking interpreter.
+				std::vector<Value> arguments(stackTop - argCount, stackTop);
+				Value result = native->call(nullptr, arguments);
+				while (argCount-- >= 0)
+				{
+					pop();
+				}
+				push(result);
+				return;
+			}
+			default:
+				break;
+		}
+	}
+	runtimeError(L"Can only call functions and classes.");
+}
+
+void
+VM::invoke(const LoxString *name, int argCount)
+{
+	const Value &receiver = peek(argCount);
+	if (!receiver.isObjectType(ObjectType::VM_INSTANCE))
+	{
+		runtimeError(L"Only instances have properties.");
+	}
+
+	VmInstance *instance = static_cast<VmInstance *>(receiver.asObject().get());
+
+	// A field holding a function shadows a method of the same name.
+	auto it = instance->fields.find(name);
+	if (it != instance->fields.end())
+	{
+		Value value = it->second;
+		stackTop[-argCount - 1] = value;
+		callValue(value, argCount);
+		return;
+	}
+
+	invokeFromClass(instance->klass.get(), name, argCount);
+}
+
+void
+VM::invokeFromClass(VmClass *klass, const LoxString *name, int argCount)
+{
+	auto it = klass->methods.find(name);
+	if (it == klass->methods.end())
+	{
+		runtimeError(L"Undefined property '" + name->value + L"'.");
+	}
+	call(static_cast<VmClosure *>(it->second.asObject().get()), argCount);
+}
+
+void
+VM::bindMethod(VmClass *klass, const LoxString *name)
+{
+	auto it = klass->methods.find(name);
+	if (it == klass->methods.end())
+	{
+		runtimeError(L"Undefined property '" + name->value + L"'.");
+	}
+
+	std::shared_ptr<VmBoundMethod> bound = Heap::allocate<VmBoundMethod>(peek(0),
+		it->second.as<VmClosure>());
+	stackTop[-1] = Value(bound);
+}
+
+std::shared_ptr<VmUpvalue>
+VM::captureUpvalue(Value *local)
+{
+	std::shared_ptr<VmUpvalue> prevUpvalue;
+	std::shared_ptr<VmUpvalue> upvalue = openUpvalues;
+	while (upvalue && upvalue->location > local)
+	{
+		prevUpvalue = upvalue;
+		upvalue = upvalue->next;
+	}
+
+	if (upvalue && upvalue->location == local)
+	{
+		return upvalue;
+	}
+
+	std::shared_ptr<VmUpvalue> createdUpvalue = Heap::allocate<VmUpvalue>(local);
+	createdUpvalue->next = upvalue;
+
+	if (prevUpvalue)
+	{
+		prevUpvalue->next = createdUpvalue;
+	}
+	else
+	{
+		openUpvalues = createdUpvalue;
+	}
+	return createdUpvalue;
+}
+
+void
+VM::closeUpvalues(Value *last)
+{
+	while (openUpvalues && openUpvalues->location >= last)
+	{
+		std::shared_ptr<VmUpvalue> upvalue = openUpvalues;
+		upvalue->closed = *upvalue->location;
+		upvalue->location = &upvalue->closed;
+		openUpvalues = upvalue->next;
+		upvalue->next.reset();
+	}
+}
+
+void
+VM::defineMethod(const LoxString *name)
+{
+	Value method = peek(0);
+	VmClass *klass = static_cast<VmClass *>(peek(1).asObject().get());
+	klass->methods.insert_or_assign(name, method);
+	pop();
+}
+
+void
+VM::defineNative(const std::wstring &name, std::shared_ptr<LoxCallable> function)
+{
+	GlobalVariable &global = globals.at(globalIndex(name));
+	global.value = Value(function);
+	global.defined = true;
+}
+
+void
+VM::resetStack()
+{
+	while (stackTop > stack.data())
+	{
+		pop();
+	}
+	frameCount = 0;
+
+	while (openUpvalues)
+	{
+		openUpvalues = openUpvalues->next;
+	}
+}
+
+void
+VM::runtimeError(const std::wstring &message)
+{
+	CallFrame &frame = frames[frameCount - 1];
+	const Chunk &chunk = frame.closure->function->chunk;
+	std::size_t instruction = frame.ip - chunk.code.data() - 1;
+	throw RuntimeError(chunk.lines.at(instruction), message);
+}
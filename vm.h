@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "expr.h"
+#include "stmt.h"
+#include "value.h"
+#include "loxcallable.h"
+#include "vmobjects.h"
+
+/*
+ * An ongoing function call, from 24.3.
+ */
+class CallFrame
+{
+public:
+	VmClosure *closure = nullptr;
+
+	uint8_t *ip = nullptr;
+
+	/*
+	 * First stack slot used by the function.
+	 */
+	Value *slots = nullptr;
+};
+
+/*
+ * A global variable. The compiler resolves global variables to an index,
+ * so that they are not looked up by name at runtime.
+ */
+class GlobalVariable
+{
+public:
+	std::shared_ptr<LoxString> name;
+
+	Value value;
+
+	bool defined = false;
+};
+
+/**
+ * Stack-based bytecode virtual machine, from Chapters 14-28 of the book.
+ * An alternative to the tree-walking Interpreter.
+ */
+class VM
+{
+public:
+	VM();
+
+	void interpret(const std::vector<Stmt *> &statements);
+
+	/*
+	 * Get the interned string for an identifier. Fields and methods are
+	 * keyed by pointer, so the VM keeps every identifier alive.
+	 */
+	std::shared_ptr<LoxString> identifier(const std::wstring &name);
+
+	/*
+	 * Get the index of a global variable, adding it if necessary.
+	 */
+	std::size_t globalIndex(const std::wstring &name);
+
+private:
+	static const int FRAMES_MAX = 512;
+	static const int STACK_MAX = FRAMES_MAX * 256;
+
+	std::vector<Value> stack;
+
+	Value *stackTop;
+
+	std::vector<CallFrame> frames;
+
+	int frameCount = 0;
+
+	std::vector<GlobalVariable> globals;
+
+	std::unordered_map<std::wstring, std::size_t> globalIndices;
+
+	std::unordered_set<std::shared_ptr<LoxString>> identifiers;
+
+	/*
+	 * Upvalues still pointing to stack slots, in order of decreasing slot.
+	 */
+	std::shared_ptr<VmUpvalue> openUpvalues;
+
+	std::shared_ptr<LoxString> initString;
+
+	void run();
+
+	void push(const Value &value);
+
+	Value pop();
+
+	const Value &peek(int distance);
+
+	void call(VmClosure *closure, int argCount);
+
+	void callValue(const Value &callee, int argCount);
+
+	void invoke(const LoxString *name, int argCount);
+
+	void invokeFromClass(VmClass *klass, const LoxString *name, int argCount);
+
+	void bindMethod(VmClass *klass, const LoxString *name);
+
+	std::shared_ptr<VmUpvalue> captureUpvalue(Value *local);
+
+	void closeUpvalues(Value *last);
+
+	void defineMethod(const LoxString *name);
+
+	void defineNative(const std::wstring &name, std::shared_ptr<LoxCallable> function);
+
+	void resetStack();
+
+	void runtimeError(const std::wstring &message);
+};
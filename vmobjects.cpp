@@ -0,0 +1,165 @@
+#include "vmobjects.h"
+
+VmFunction::VmFunction() :
+	LoxObject(ObjectType::VM_FUNCTION)
+{
+}
+
+std::wstring
+VmFunction::toString()
+{
+	if (!name)
+	{
+		return L"<script>";
+	}
+	return L"<fn " + name->value + L">";
+}
+
+VmUpvalue::VmUpvalue(Value *_location) :
+	LoxObject(ObjectType::VM_UPVALUE),
+	location(_location)
+{
+}
+
+std::wstring
+VmUpvalue::toString()
+{
+	return L"upvalue";
+}
+
+VmClosure::VmClosure(std::shared_ptr<VmFunction> _function) :
+	LoxObject(ObjectType::VM_CLOSURE),
+	function(_function),
+	upvalues(_function->upvalueCount)
+{
+}
+
+std::wstring
+VmClosure::toString()
+{
+	return function->toString();
+}
+
+VmClass::VmClass(std::shared_ptr<LoxString> _name) :
+	LoxObject(ObjectType::VM_CLASS),
+	name(_name)
+{
+}
+
+std::wstring
+VmClass::toString()
+{
+	return name->value;
+}
+
+VmInstance::VmInstance(std::shared_ptr<VmClass> _klass) :
+	LoxObject(ObjectType::VM_INSTANCE),
+	klass(_klass)
+{
+}
+
+std::wstring
+VmInstance::toString()
+{
+	return klass->name->value + L" instance";
+}
+
+VmBoundMethod::VmBoundMethod(const Value &_receiver, std::shared_ptr<VmClosure> _method) :
+	LoxObject(ObjectType::VM_BOUND_METHOD),
+	receiver(_receiver),
+	method(_method)
+{
+}
+
+std::wstring
+VmBoundMethod::toString()
+{
+	return method->toString();
+}
+
+void
+VmUpvalue::traceReferences(std::vector<HeapObject *> &references)
+{
+	closed.traceReference(references);
+	if (next)
+	{
+		references.push_back(next.get());
+	}
+}
+
+void
+VmUpvalue::clearReferences()
+{
+	closed = Value();
+	next.reset();
+}
+
+void
+VmClosure::traceReferences(std::vector<HeapObject *> &references)
+{
+	for (const auto &upvalue : upvalues)
+	{
+		if (upvalue)
+		{
+			references.push_back(upvalue.get());
+		}
+	}
+}
+
+void
+VmClosure::clearReferences()
+{
+	upvalues.clear();
+}
+
+void
+VmClass::traceReferences(std::vector<HeapObject *> &references)
+{
+	for (const auto &method : methods)
+	{
+		method.second.traceReference(references);
+	}
+}
+
+void
+VmClass::clearReferences()
+{
+	methods.clear();
+}
+
+void
+VmInstance::traceReferences(std::vector<HeapObject *> &references)
+{
+	if (klass)
+	{
+		references.push_back(klass.get());
+	}
+	for (const auto &field : fields)
+	{
+		field.second.traceReference(references);
+	}
+}
+
+void
+VmInstance::clearReferences()
+{
+	klass.reset();
+	fields.clear();
+}
+
+void
+VmBoundMethod::traceReferences(std::vector<HeapObject *> &references)
+{
+	receiver.traceReference(references);
+	if (method)
+	{
+		references.push_back(method.get());
+	}
+}
+
+void
+VmBoundMethod::clearReferences()
+{
+	receiver = Value();
+	method.reset();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "loxobject.h"
+#include "loxstring.h"
+#include "value.h"
+#include "chunk.h"
+
+/*
+ * Runtime objects of the bytecode virtual machine, from Chapters 24-28 of
+ * the book. Property and method names are identifiers interned by the VM,
+ * so they are looked up by pointer.
+ */
+
+/**
+ * A function compiled to bytecode.
+ */
+class VmFunction : public LoxObject
+{
+public:
+	VmFunction();
+
+	std::wstring toString();
+
+	int arity = 0;
+
+	int upvalueCount = 0;
+
+	Chunk chunk;
+
+	/*
+	 * Function name, or null for the top-level script.
+	 */
+	std::shared_ptr<LoxString> name;
+};
+
+/**
+ * A variable captured by a closure. Points to the stack slot while the
+ * variable is in scope and to its own copy after it has been closed.
+ */
+class VmUpvalue : public LoxObject
+{
+public:
+	VmUpvalue(Value *_location);
+
+	std::wstring toString();
+
+	Value *location;
+
+	Value closed;
+
+	/*
+	 * Next open upvalue, in order of decreasing stack slot.
+	 */
+	std::shared_ptr<VmUpvalue> next;
+
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+};
+
+/**
+ * A function together with the variables it has captured.
+ */
+class VmClosure : public LoxObject
+{
+public:
+	VmClosure(std::shared_ptr<VmFunction> _function);
+
+	std::wstring toString();
+
+	std::shared_ptr<VmFunction> function;
+
+	std::vector<std::shared_ptr<VmUpvalue>> upvalues;
+
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+};
+
+class VmClass : public LoxObject
+{
+public:
+	VmClass(std::shared_ptr<LoxString> _name);
+
+	std::wstring toString();
+
+	std::shared_ptr<LoxString> name;
+
+	std::unordered_map<const LoxString *, Value> methods;
+
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+};
+
+class VmInstance : public LoxObject
+{
+public:
+	VmInstance(std::shared_ptr<VmClass> _klass);
+
+	std::wstring toString();
+
+	std::shared_ptr<VmClass> klass;
+
+	std::unordered_map<const LoxString *, Value> fields;
+
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+};
+
+/**
+ * A method taken from an instance as a first-class value.
+ */
+class VmBoundMethod : public LoxObject
+{
+public:
+	VmBoundMethod(const Value &_receiver, std::shared_ptr<VmClosure> _method);
+
+	std::wstring toString();
+
+	Value receiver;
+
+	std::shared_ptr<VmClosure> method;
+
+	void traceReferences(std::vector<HeapObject *> &references);
+
+	void clearReferences();
+};